@@ -3,9 +3,11 @@
 #include "Players/Player.h"
 
 #include "Players/Console.h"
+#include "Players/External.h"
 #include "Players/Random.h"
 
 #include "Players/Negamax.h"
+#include "Players/MateSolver.h"
 
 #include "Players/SameColor.h"
 #include "Players/OppositeColor.h"
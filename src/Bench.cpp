@@ -0,0 +1,472 @@
+#include "Bench.h"
+#include "AllPlayers.h"
+#include "Platform.h"
+
+#include "Engine/Counters.h"
+#include "Engine/Magic.h"
+#include "Engine/PerfCounters.h"
+#include "Engine/Test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <omp.h>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_RDTSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define HAS_RDTSC 1
+#endif
+
+static const char* positions[] = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+	"4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+	"rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+	"r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+	"r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+	"r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+	"r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+	"4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+	"2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+	"r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+	"3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+	"r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+	"4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+	"3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+	"6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+	"3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+	"2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+	"8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+	"7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+	"8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+	"8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+	"8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+	"8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+	"5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+	"6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+	"1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+	"6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+	"8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+	"5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+	"4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+	"r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+	"3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+	"4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+	"r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+	"rnbqkb1r/pp1p1ppp/4pn2/2p5/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 0 4",
+	"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2",
+	"r1b2rk1/2q1b1pp/p2ppn2/1p6/3QP3/1BN1B3/PPP3PP/R4RK1 w - - 0 1",
+	"8/k7/3p4/p2P1p2/P2P1P2/8/8/K7 w - - 0 1",
+
+	// few pieces
+	"8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+	"8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+	"8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+	"8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+	"8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+	"8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+	"8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+
+	// mate and stalemate
+	"6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+	"r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+	"8/8/8/8/8/6k1/6p1/6K1 w - - 0 1",
+	"7k/7P/6K1/8/3B4/8/8/8 b - - 0 1",
+};
+
+struct BenchResult {
+	std::string Fen;
+	uint64_t Nodes;
+	Move Best;
+};
+
+void Bench(int depth, const std::string& jsonPath, bool counters) {
+	Players::Negamax player;
+
+	Players::SearchLimits limits;
+	limits.Depth = std::max(depth - 1, 0); // the root move is one ply by itself
+
+	std::vector<BenchResult> results;
+	uint64_t nodes = 0;
+
+	Counters::Reset();
+	PerfCounters perf;
+	if(counters) {
+		perf.Start();
+	}
+	const auto begin = std::chrono::steady_clock::now();
+
+	for(const auto fen : positions) {
+		// every position starts from empty tables so the result doesn't depend on the order
+		player.NewGame();
+
+		auto game = ChessEngine(fen);
+		const auto best = player.Search(game, limits);
+
+		results.push_back({ fen, player.Stats().Nodes, best });
+		nodes += player.Stats().Nodes;
+
+		std::cout << "Position " << results.size() << "/" << std::size(positions) << ": ";
+		// mate and stalemate positions have no move
+		if(best.Type == MoveType::Error) {
+			std::cout << "none";
+		} else {
+			std::cout << best;
+		}
+		std::cout << " " << player.Stats().Nodes << " nodes" << std::endl;
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	const auto values = perf.Stop();
+	const auto ms = std::max<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count(), 1);
+	const auto nps = nodes * 1000 / ms;
+
+	std::cout
+		<< "===========================" << std::endl
+		<< "Total time (ms) : " << ms << std::endl
+		<< "Nodes searched  : " << nodes << std::endl
+		<< "Nodes/second    : " << nps << std::endl;
+
+	if(counters) {
+		if(perf.Available()) {
+			PerfCounters::Print(values, nodes);
+		} else {
+			std::cout << "Hardware counters unavailable: " << perf.Error() << std::endl;
+		}
+	}
+	if(Counters::Enabled) {
+		std::cout << Counters::Report() << std::flush;
+	}
+
+	if(jsonPath.empty()) {
+		return;
+	}
+
+	std::ofstream json(jsonPath);
+	json << "{\n"
+		<< "  \"depth\": " << depth << ",\n"
+		<< "  \"nodes\": " << nodes << ",\n"
+		<< "  \"time_ms\": " << ms << ",\n"
+		<< "  \"nps\": " << nps << ",\n"
+		<< "  \"positions\": [\n";
+
+	for(size_t i = 0; i < results.size(); i++) {
+		std::stringstream best;
+		if(results[i].Best.Type != MoveType::Error) {
+			best << results[i].Best;
+		}
+
+		json << "    { \"fen\": \"" << results[i].Fen << "\", \"nodes\": " << results[i].Nodes << ", \"bestmove\": \"" << best.str() << "\" }"
+			<< (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	json << "  ]\n}\n";
+}
+
+#pragma region Microbenchmarks
+
+// operations per timed sample, small enough for a meaningful p99 and large enough to hide the clock overhead
+constexpr size_t SampleSize = 256;
+constexpr size_t Samples = 4000;
+
+struct Timing {
+	double Median = 0; // ns/op
+	double P99 = 0;	   // ns/op
+	double Cycles = 0; // tsc cycles/op, 0 without rdtsc
+};
+
+static uint64_t Cycles() {
+#ifdef HAS_RDTSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+// func(i) runs operation i of count and returns something to keep the compiler from dropping it
+template<class F>
+static Timing Measure(size_t count, F&& func) {
+	uint64_t sink = 0;
+
+	// warm-up: one pass over the corpus brings tables and code into the caches
+	for(size_t i = 0; i < count; i++) {
+		sink += func(i);
+	}
+
+	std::vector<double> times(Samples), cycles(Samples);
+	size_t next = 0;
+
+	for(size_t s = 0; s < Samples; s++) {
+		const auto begin = std::chrono::steady_clock::now();
+		const auto beginCycles = Cycles();
+
+		for(size_t i = 0; i < SampleSize; i++) {
+			sink += func(next);
+			if(++next == count) next = 0;
+		}
+
+		const auto endCycles = Cycles();
+		const auto end = std::chrono::steady_clock::now();
+
+		times[s] = std::chrono::duration<double, std::nano>(end - begin).count() / SampleSize;
+		cycles[s] = (double)(endCycles - beginCycles) / SampleSize;
+	}
+
+	DoNotOptimize(sink);
+
+	std::sort(times.begin(), times.end());
+	std::sort(cycles.begin(), cycles.end());
+	return { times[Samples / 2], times[Samples * 99 / 100], cycles[Samples / 2] };
+}
+
+static std::map<std::string, Timing> ReadBaseline(const std::string& path) {
+	std::map<std::string, Timing> baseline;
+	std::ifstream file(path);
+
+	std::string name;
+	Timing timing;
+	while(file >> name >> timing.Median >> timing.P99 >> timing.Cycles) {
+		baseline[name] = timing;
+	}
+	return baseline;
+}
+
+void MicroBench(const std::string& baselinePath, bool save) {
+	// positions from random games starting at the bench positions, seeded so every run times the same corpus
+	std::vector<ChessEngine> corpus;
+	std::mt19937 rng(1234);
+
+	while(corpus.size() < 20000) {
+		auto game = ChessEngine(positions[rng() % std::size(positions)]);
+		for(int ply = 0; ply < 40; ply++) {
+			auto moves = game.GetValidMoves();
+			if(moves.empty()) break;
+			corpus.push_back(game);
+
+			game.MakeMove(moves[rng() % moves.size()]);
+			if(!game.IsValid()) break;
+		}
+	}
+
+	// one pseudo legal move per position and the positions after it
+	std::vector<Move> moves;
+	std::vector<ChessEngine> children;
+	for(auto& pos : corpus) {
+		auto cp = pos;
+		auto list = cp.GetMoves();
+		const auto move = list[rng() % list.size()];
+		moves.push_back(move);
+
+		auto child = pos;
+		child.MakeMove(move);
+		children.push_back(child);
+	}
+
+	// slider lookups with the real occupancy of every square
+	std::vector<std::pair<int, uint64_t>> squares;
+	for(size_t i = 0; i < corpus.size(); i += 10) {
+		for(int square = 0; square < 64; square++) {
+			squares.emplace_back(square, corpus[i].occupied);
+		}
+	}
+
+	PawnTable pawns;
+	std::vector<std::pair<std::string, Timing>> results;
+
+	results.emplace_back("MakeMove", Measure(corpus.size(), [&](size_t i) {
+		auto cp = corpus[i];
+		cp.MakeMove(moves[i]);
+		return cp.Hash;
+	}));
+	results.emplace_back("GetMoves", Measure(corpus.size(), [&](size_t i) {
+		auto cp = corpus[i];
+		return (uint64_t)cp.GetMoves().size();
+	}));
+	results.emplace_back("IsValid", Measure(children.size(), [&](size_t i) {
+		return (uint64_t)children[i].IsValid();
+	}));
+	results.emplace_back("UnsafeForWhite", Measure(corpus.size(), [&](size_t i) {
+		return corpus[i].UnsafeForWhite();
+	}));
+	results.emplace_back("StraightMask", Measure(squares.size(), [&](size_t i) {
+		return StraightMask(squares[i].first, squares[i].second);
+	}));
+	results.emplace_back("DiagMask", Measure(squares.size(), [&](size_t i) {
+		return DiagMask(squares[i].first, squares[i].second);
+	}));
+	results.emplace_back("eval", Measure(corpus.size(), [&](size_t i) {
+		return (uint64_t)eval(corpus[i], pawns);
+	}));
+
+	const auto baseline = save ? std::map<std::string, Timing>() : ReadBaseline(baselinePath);
+
+	std::cout << "Corpus: " << corpus.size() << " positions, " << Samples << " samples of " << SampleSize << " ops\n";
+	std::cout << std::left << std::setw(16) << "function" << std::right
+		<< std::setw(12) << "median ns" << std::setw(12) << "p99 ns" << std::setw(12) << "cycles"
+		<< (baseline.empty() ? "" : "   vs baseline") << "\n";
+	std::cout << std::fixed << std::setprecision(2);
+
+	for(const auto& [name, timing] : results) {
+		std::cout << std::left << std::setw(16) << name << std::right
+			<< std::setw(12) << timing.Median << std::setw(12) << timing.P99 << std::setw(12) << timing.Cycles;
+
+		const auto it = baseline.find(name);
+		if(it != baseline.end()) {
+			const auto change = (timing.Median / it->second.Median - 1) * 100;
+			std::cout << "   " << std::showpos << change << "%" << std::noshowpos;
+			// noise on an idle machine stays within a few percent
+			if(change > 5) {
+				std::cout << " slower";
+			}
+		}
+		std::cout << "\n";
+	}
+	std::cout << std::defaultfloat;
+
+	if(save && !baselinePath.empty()) {
+		std::ofstream file(baselinePath);
+		for(const auto& [name, timing] : results) {
+			file << name << " " << timing.Median << " " << timing.P99 << " " << timing.Cycles << "\n";
+		}
+		std::cout << "Saved baseline to " << baselinePath << std::endl;
+	}
+}
+#pragma endregion
+
+#pragma region Thread scaling
+
+constexpr int ScalingPerftDepth = 6;
+constexpr int ScalingSearchDepth = 7;
+// the search part uses the first bench positions
+constexpr int ScalingPositions = 8;
+
+struct ScalingResult {
+	double Mean = 0;   // seconds
+	double StdDev = 0; // seconds
+	double Nps = 0;
+	double Speedup = 1;
+	double Efficiency = 1;
+};
+
+template<class F>
+static ScalingResult Repeat(int repetitions, F&& run) {
+	std::vector<double> times;
+	uint64_t nodes = 0;
+
+	for(int i = 0; i < repetitions; i++) {
+		const auto begin = std::chrono::steady_clock::now();
+		nodes += run();
+		times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+	}
+
+	ScalingResult result;
+	for(const auto time : times) {
+		result.Mean += time / times.size();
+	}
+	for(const auto time : times) {
+		result.StdDev += (time - result.Mean) * (time - result.Mean);
+	}
+	result.StdDev = times.size() > 1 ? std::sqrt(result.StdDev / (times.size() - 1)) : 0;
+	result.Nps = nodes / std::max(result.Mean * repetitions, 1e-9);
+	return result;
+}
+
+static void WriteScaling(std::ostream& json, const ScalingResult& result) {
+	json << "{ \"mean\": " << result.Mean << ", \"stddev\": " << result.StdDev << ", \"nps\": " << (uint64_t)result.Nps
+		<< ", \"speedup\": " << result.Speedup << ", \"efficiency\": " << result.Efficiency << " }";
+}
+
+void Scaling(int maxThreads, int repetitions, const std::string& jsonPath) {
+	maxThreads = std::max(maxThreads > 0 ? maxThreads : omp_get_num_procs(), 1);
+	repetitions = std::max(repetitions, 1);
+
+	// powers of two and the full thread count
+	std::vector<int> threadCounts;
+	for(int threads = 1; threads < maxThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	const auto defaultThreads = omp_get_max_threads();
+	const auto start = ChessEngine();
+	Players::Negamax player;
+
+	Players::SearchLimits limits;
+	limits.Depth = ScalingSearchDepth - 1; // the root move is one ply by itself
+
+	std::vector<std::pair<ScalingResult, ScalingResult>> results;
+
+	std::cout << "perft depth " << ScalingPerftDepth << ", search depth " << ScalingSearchDepth << " on " << ScalingPositions << " positions, "
+		<< repetitions << " repetitions\n\n";
+	std::cout << "threads      perft s      sd  speedup   eff      Mnps     search s      sd  speedup   eff      knps\n";
+	std::cout << std::fixed;
+
+	for(const auto threads : threadCounts) {
+		omp_set_num_threads(threads);
+		auto perft = Repeat(repetitions, [&]() { return PerftNodes(start, ScalingPerftDepth); });
+
+		player.Threads = threads;
+		auto search = Repeat(repetitions, [&]() {
+			uint64_t nodes = 0;
+			for(int i = 0; i < ScalingPositions; i++) {
+				player.NewGame();
+				auto game = ChessEngine(positions[i]);
+				player.Search(game, limits);
+				nodes += player.Stats().Nodes;
+			}
+			return nodes;
+		});
+
+		// relative to one thread
+		if(!results.empty()) {
+			perft.Speedup = results[0].first.Mean / perft.Mean;
+			search.Speedup = results[0].second.Mean / search.Mean;
+		}
+		perft.Efficiency = perft.Speedup / threads;
+		search.Efficiency = search.Speedup / threads;
+		results.emplace_back(perft, search);
+
+		std::cout << std::setw(7) << threads
+			<< std::setprecision(3) << std::setw(13) << perft.Mean << std::setw(8) << perft.StdDev
+			<< std::setprecision(2) << std::setw(9) << perft.Speedup << std::setw(6) << perft.Efficiency
+			<< std::setprecision(1) << std::setw(10) << perft.Nps / 1e6
+			<< std::setprecision(3) << std::setw(13) << search.Mean << std::setw(8) << search.StdDev
+			<< std::setprecision(2) << std::setw(9) << search.Speedup << std::setw(6) << search.Efficiency
+			<< std::setprecision(0) << std::setw(10) << search.Nps / 1e3 << std::endl;
+	}
+	std::cout << std::defaultfloat;
+
+	omp_set_num_threads(defaultThreads);
+
+	if(jsonPath.empty()) {
+		return;
+	}
+
+	std::ofstream json(jsonPath);
+	json << "{\n"
+		<< "  \"perft_depth\": " << ScalingPerftDepth << ",\n"
+		<< "  \"search_depth\": " << ScalingSearchDepth << ",\n"
+		<< "  \"search_positions\": " << ScalingPositions << ",\n"
+		<< "  \"repetitions\": " << repetitions << ",\n"
+		<< "  \"results\": [\n";
+
+	for(size_t i = 0; i < results.size(); i++) {
+		json << "    { \"threads\": " << threadCounts[i] << ", \"perft\": ";
+		WriteScaling(json, results[i].first);
+		json << ", \"search\": ";
+		WriteScaling(json, results[i].second);
+		json << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	json << "  ]\n}\n";
+}
+#pragma endregion
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+
+// Fixed depth search over built in positions, the total node count changes with any change to the search or evaluation
+void Bench(int depth, const std::string& jsonPath, bool counters = false);
+
+// Times single engine functions on positions from seeded random games, baselinePath is compared against or written with save
+void MicroBench(const std::string& baselinePath, bool save);
+
+// Parallel perft and search time to depth at 1, 2, 4 ... maxThreads threads (0 for all cores)
+void Scaling(int maxThreads, int repetitions, const std::string& jsonPath);
@@ -0,0 +1,208 @@
+#include "DataGen.h"
+#include "AllPlayers.h"
+#include "Platform.h"
+#include "Tournament.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <omp.h>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+PackedPosition PackedPosition::Pack(const ChessEngine& game, int score, int result) {
+	PackedPosition packed{};
+	packed.Occupied = game.White | game.Black;
+
+	const uint64_t boards[] = { game.P, game.N, game.B, game.R, game.Q, game.K };
+
+	int count = 0;
+	for(auto rest = packed.Occupied; rest; rest &= rest - 1) {
+		const auto mask = rest & ~(rest - 1);
+
+		int type = 0;
+		while(!(boards[type] & mask)) type++;
+
+		// same order as Piece, white and black alternate
+		const uint8_t piece = type * 2 + ((game.Black & mask) ? 1 : 0);
+		packed.Pieces[count / 2] |= piece << (count % 2 * 4);
+		count++;
+	}
+
+	packed.Score = (int16_t)score;
+	packed.Result = (uint8_t)(result + 1);
+	packed.Flags = game.WhiteMove | game.CastleWK << 1 | game.CastleWQ << 2 | game.CastleBK << 3 | game.CastleBQ << 4;
+	packed.EnPassant = game.EP ? (uint8_t)NumberOfTrailingZeros(game.EP) : 64;
+	packed.HalfMoves = (uint8_t)std::min(game.HalfMoves, 255);
+	packed.FullMoves = (uint16_t)game.FullMoves;
+	return packed;
+}
+
+ChessEngine PackedPosition::Unpack() const {
+	ChessEngine game;
+	game.White = game.Black = game.P = game.N = game.B = game.R = game.Q = game.K = 0;
+
+	uint64_t* boards[] = { &game.P, &game.N, &game.B, &game.R, &game.Q, &game.K };
+
+	int count = 0;
+	for(auto rest = Occupied; rest; rest &= rest - 1) {
+		const auto mask = rest & ~(rest - 1);
+		const auto piece = (Pieces[count / 2] >> (count % 2 * 4)) & 15;
+		count++;
+
+		*boards[piece / 2] |= mask;
+		(piece & 1 ? game.Black : game.White) |= mask;
+	}
+
+	game.WhiteMove = Flags & 1;
+	game.CastleWK = Flags & 2;
+	game.CastleWQ = Flags & 4;
+	game.CastleBK = Flags & 8;
+	game.CastleBQ = Flags & 16;
+	game.EP = EnPassant < 64 ? 1ULL << EnPassant : 0;
+	game.HalfMoves = HalfMoves;
+	game.FullMoves = FullMoves;
+	game.Refresh();
+	return game;
+}
+
+namespace {
+	// Searches every move of both sides and keeps the quiet positions with their score until the game is over
+	class Recorder : public Players::Player {
+	public:
+		struct Entry {
+			ChessEngine Game;
+			int Score;
+		};
+		std::vector<Entry> Entries;
+
+		Recorder(uint64_t nodes) {
+			engine.SetHashSize(8);
+			engine.Limits.Nodes = nodes;
+			engine.OnIteration = [&](const Players::SearchInfo& info) {
+				score = info.Score;
+				scored = true;
+			};
+		}
+
+		void NewGame() {
+			engine.NewGame();
+			Entries.clear();
+		}
+
+		Move MakeMove(ChessEngine& game) override {
+			// the check flag is only known after generating moves
+			auto cp = game;
+			cp.GetMoves();
+
+			engine.SetHistory(history);
+			scored = false;
+			const auto move = engine.Search(game, engine.Limits);
+
+			// checks, captures and mates have scores the static evaluation can't explain
+			if(scored && move.Type != MoveType::Error && !cp.IsCheck() && !game.IsCapture(move) && std::abs(score) < Players::MateBound) {
+				Entries.push_back({ game, game.WhiteMove ? score : -score });
+			}
+			return move;
+		}
+	private:
+		Players::Negamax engine;
+		int score = 0;
+		// at least one iteration finished
+		bool scored = false;
+	};
+}
+
+// plies played at random before the engine takes over
+constexpr int RandomPlies = 8;
+// records buffered per thread before they are written
+constexpr size_t BufferSize = 1 << 15;
+
+static bool RandomOpening(ChessEngine& game, std::mt19937_64& rng) {
+	game = ChessEngine();
+
+	// an odd number of plies half of the time so black starts as often as white
+	const auto plies = RandomPlies + (int)(rng() & 1);
+	for(int i = 0; i < plies; i++) {
+		auto moves = game.GetValidMoves();
+		if(moves.empty()) return false;
+
+		game.MakeMove(moves[rng() % moves.size()]);
+		if(!game.IsValid()) return false;
+	}
+
+	auto cp = game;
+	return !cp.GetValidMoves().empty();
+}
+
+void DataGen(const std::string& prefix, uint64_t positions, uint64_t nodes, uint64_t seed) {
+	std::atomic<uint64_t> written = 0;
+	std::atomic<uint64_t> games = 0;
+	std::atomic<bool> failed = false;
+
+	const auto begin = std::chrono::steady_clock::now();
+	auto lastReport = begin;
+
+#pragma omp parallel
+	{
+		const auto path = prefix + "." + std::to_string(omp_get_thread_num()) + ".bin";
+		const auto file = fopen(path.c_str(), "ab");
+		if(!file) {
+			failed = true;
+		}
+
+		std::vector<PackedPosition> buffer;
+		buffer.reserve(BufferSize);
+
+		const auto flush = [&]() {
+			if(file && fwrite(buffer.data(), sizeof(PackedPosition), buffer.size(), file) != buffer.size()) {
+				failed = true;
+			}
+			buffer.clear();
+		};
+
+		Recorder recorder(nodes);
+		const Adjudication rules;
+
+		while(!failed && written < positions) {
+			// the game number picks the opening, so a seed always produces the same set of games
+			const auto number = games++;
+			std::mt19937_64 rng(seed ^ (number * 0x9E3779B97F4A7C15ULL));
+
+			ChessEngine start;
+			if(!RandomOpening(start, rng)) {
+				continue;
+			}
+
+			recorder.NewGame();
+			const auto result = Play(recorder, recorder, rules, start);
+
+			for(const auto& entry : recorder.Entries) {
+				buffer.push_back(PackedPosition::Pack(entry.Game, entry.Score, result.Score));
+			}
+			written += recorder.Entries.size();
+
+			if(buffer.size() >= BufferSize) {
+				flush();
+			}
+
+			if(omp_get_thread_num() == 0 && std::chrono::steady_clock::now() - lastReport > std::chrono::seconds(10)) {
+				lastReport = std::chrono::steady_clock::now();
+				const auto passed = std::chrono::duration<double>(lastReport - begin).count();
+				printf("%llu positions %llu games %.0f positions/s\n", (unsigned long long)written, (unsigned long long)games, written / passed);
+				fflush(stdout);
+			}
+		}
+
+		flush();
+		if(file) fclose(file);
+	}
+
+	if(failed) {
+		throw std::runtime_error("Could not write " + prefix + ".*.bin");
+	}
+
+	const auto passed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	printf("%llu positions from %llu games in %.1fs = %.0f positions/s\n", (unsigned long long)written, (unsigned long long)games, passed, written / passed);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "Engine/ChessEngine.h"
+
+#include <cstdint>
+#include <string>
+
+// One labelled training position. Squares are bit indices with 0 = h1, the pieces are stored in order of their square
+struct PackedPosition {
+	uint64_t Occupied;
+	// Piece values, two per byte with the low nibble first
+	uint8_t Pieces[16];
+	// search score in centipawns from white's view
+	int16_t Score;
+	// 0 black won, 1 draw, 2 white won
+	uint8_t Result;
+	// bit 0 white to move, bits 1 to 4 castling rights KQkq
+	uint8_t Flags;
+	// square of the pawn that can be taken en passant, 64 if none
+	uint8_t EnPassant;
+	uint8_t HalfMoves;
+	uint16_t FullMoves;
+
+	static PackedPosition Pack(const ChessEngine& game, int score, int result);
+	ChessEngine Unpack() const;
+};
+static_assert(sizeof(PackedPosition) == 32);
+
+// Fixed node self-play from random openings on all cores until positions are written, every thread appends to <prefix>.<thread>.bin
+void DataGen(const std::string& prefix, uint64_t positions, uint64_t nodes, uint64_t seed);
@@ -0,0 +1,453 @@
+#include "Bitbase.h"
+#include "ChessConstants.h"
+#include "Magic.h"
+#include "Platform.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+
+constexpr char FileMagic[4] = { 'D', 'B', 'B', '1' };
+constexpr int HeaderSize = 16;
+
+constexpr uint8_t Unknown = 4;
+
+constexpr char PieceNames[] = "PNBRQ";
+constexpr int PieceValues[] = { 1, 3, 3, 5, 9 };
+
+// 4 bits per color and piece type
+static int SignatureShift(int type, int color) {
+	return (color * 5 + type) * 4;
+}
+
+static int SignatureCount(uint64_t signature, int type, int color) {
+	return (signature >> SignatureShift(type, color)) & 0xF;
+}
+
+static uint64_t FlipSignature(uint64_t signature) {
+	return (signature >> 20) | ((signature & 0xFFFFF) << 20);
+}
+
+uint64_t MaterialSignature(const ChessEngine& game) {
+	const uint64_t types[5] = { game.P, game.N, game.B, game.R, game.Q };
+	uint64_t signature = 0;
+
+	for(int type = 0; type < 5; type++) {
+		signature |= (uint64_t)popcnt64(types[type] & game.White) << SignatureShift(type, 0);
+		signature |= (uint64_t)popcnt64(types[type] & game.Black) << SignatureShift(type, 1);
+	}
+
+	return signature;
+}
+
+// Name with the stronger side as white, pieces ordered from queen to pawn
+static std::string CanonicalName(uint64_t signature) {
+	std::string sides[2];
+	int values[2] = { 0, 0 };
+
+	for(int color = 0; color < 2; color++) {
+		sides[color] = "K";
+		for(int type = 4; type >= 0; type--) {
+			const auto count = SignatureCount(signature, type, color);
+			sides[color].append(count, PieceNames[type]);
+			values[color] += count * PieceValues[type];
+		}
+	}
+
+	if(values[1] > values[0] || (values[1] == values[0] && sides[1] > sides[0])) {
+		std::swap(sides[0], sides[1]);
+	}
+
+	return sides[0] + sides[1];
+}
+
+// Material sets reachable with one capture and/or promotion
+static std::set<uint64_t> Dependencies(uint64_t signature) {
+	std::set<uint64_t> result;
+
+	for(int color = 0; color < 2; color++) {
+		for(int type = 0; type < 5; type++) {
+			if(!SignatureCount(signature, type, color)) continue;
+
+			// capture
+			const auto captured = signature - (1ULL << SignatureShift(type, color));
+			result.insert(captured);
+
+			// promotion of a pawn of the other side, with or without this capture
+			const auto other = color ^ 1;
+			if(SignatureCount(signature, 0, other)) {
+				for(int promotion = 1; promotion < 5; promotion++) {
+					result.insert(captured - (1ULL << SignatureShift(0, other)) + (1ULL << SignatureShift(promotion, other)));
+				}
+			}
+		}
+
+		if(SignatureCount(signature, 0, color)) {
+			for(int promotion = 1; promotion < 5; promotion++) {
+				result.insert(signature - (1ULL << SignatureShift(0, color)) + (1ULL << SignatureShift(promotion, color)));
+			}
+		}
+	}
+
+	return result;
+}
+
+static bool OnlyKings(uint64_t signature) {
+	return signature == 0;
+}
+
+Bitbase::Bitbase(const std::string& name) : Name(name), Signature(0) {
+	if(name.size() < 2 || name[0] != 'K') {
+		throw std::invalid_argument("Invalid bitbase name " + name);
+	}
+
+	int color = 0;
+	for(size_t i = 1; i < name.size(); i++) {
+		if(name[i] == 'K') {
+			if(color == 1) throw std::invalid_argument("Invalid bitbase name " + name);
+			color = 1;
+			continue;
+		}
+
+		const auto type = std::strchr(PieceNames, name[i]);
+		if(!type || !name[i]) {
+			throw std::invalid_argument("Invalid bitbase name " + name);
+		}
+
+		Pieces.push_back({ (int)(type - PieceNames), color });
+		Signature += 1ULL << SignatureShift(type - PieceNames, color);
+	}
+
+	if(color != 1 || Pieces.size() > 2) {
+		throw std::invalid_argument("Only 3 and 4 piece bitbases are supported: " + name);
+	}
+}
+
+Bitbase::Bitbase(const std::string& name, const std::string& path) : Bitbase(name) {
+	file = std::make_unique<MappedFile>(path);
+
+	if(file->Size() != HeaderSize + Size() / 4 || std::memcmp(file->Data(), FileMagic, 4) != 0) {
+		throw std::runtime_error("Invalid bitbase file " + path);
+	}
+
+	uint64_t signature;
+	std::memcpy(&signature, file->Data() + 8, sizeof(signature));
+	if(signature != Signature) {
+		throw std::runtime_error("Bitbase file doesn't match its name " + path);
+	}
+
+	data = file->Data() + HeaderSize;
+}
+
+uint64_t Bitbase::Index(const ChessEngine& game, bool flip) const {
+	const auto white = flip ? game.Black : game.White;
+	const auto black = flip ? game.White : game.Black;
+	const int mirror = flip ? 56 : 0;
+	const uint64_t types[5] = { game.P, game.N, game.B, game.R, game.Q };
+
+	uint64_t index = game.WhiteMove == flip;
+	index = index * 64 + (NumberOfTrailingZeros(game.K & white) ^ mirror);
+	index = index * 64 + (NumberOfTrailingZeros(game.K & black) ^ mirror);
+
+	uint64_t used = 0;
+	for(const auto& piece : Pieces) {
+		const auto board = types[piece.Type] & (piece.Color == 0 ? white : black) & ~used;
+		const auto bit = board & ~(board - 1);
+		used |= bit;
+
+		index = index * 64 + (NumberOfTrailingZeros(bit) ^ mirror);
+	}
+
+	return index;
+}
+
+static bool Decode(const Bitbase& table, uint64_t index, ChessEngine& game) {
+	static const ChessEngine empty("8/8/8/8/8/8/8/8 w - - 0 1");
+	game = empty;
+
+	const int count = table.Pieces.size() + 2;
+	int squares[4];
+	for(int i = count - 1; i >= 0; i--) {
+		squares[i] = index & 63;
+		index >>= 6;
+	}
+
+	uint64_t used = 0;
+	for(int i = 0; i < count; i++) {
+		const auto bit = 1ULL << squares[i];
+		if(used & bit) return false;
+		used |= bit;
+
+		const auto color = i < 2 ? i : table.Pieces[i - 2].Color;
+		(color == 0 ? game.White : game.Black) |= bit;
+
+		if(i < 2) {
+			game.K |= bit;
+			continue;
+		}
+
+		switch(table.Pieces[i - 2].Type) {
+			case 0:
+				if(bit & (Rank1 | Rank8)) return false;
+				game.P |= bit;
+				break;
+			case 1: game.N |= bit; break;
+			case 2: game.B |= bit; break;
+			case 3: game.R |= bit; break;
+			case 4: game.Q |= bit; break;
+		}
+	}
+
+	game.WhiteMove = index == 0;
+	game.Refresh();
+
+	return game.IsValid();
+}
+
+void Bitbase::Save(const std::string& path) const {
+	std::ofstream out(path, std::ios::binary);
+
+	const uint32_t count = Pieces.size() + 2;
+	out.write(FileMagic, 4);
+	out.write((const char*)&count, sizeof(count));
+	out.write((const char*)&Signature, sizeof(Signature));
+	out.write((const char*)data, Size() / 4);
+
+	if(!out) {
+		throw std::runtime_error("Can't write " + path);
+	}
+}
+
+const Bitbase* Bitbases::Find(uint64_t signature, bool& flip) const {
+	for(const auto& table : tables) {
+		if(table->Signature == signature) {
+			flip = false;
+			return table.get();
+		}
+	}
+	const auto flipped = FlipSignature(signature);
+	for(const auto& table : tables) {
+		if(table->Signature == flipped) {
+			flip = true;
+			return table.get();
+		}
+	}
+	return nullptr;
+}
+
+Bitbase::Value Bitbases::Lookup(const ChessEngine& game) const {
+	const auto signature = MaterialSignature(game);
+	if(OnlyKings(signature)) {
+		return Bitbase::Draw;
+	}
+
+	bool flip;
+	const auto table = Find(signature, flip);
+	if(!table) {
+		throw std::logic_error("Missing bitbase " + CanonicalName(signature));
+	}
+
+	return table->Get(table->Index(game, flip));
+}
+
+bool Bitbases::Probe(const ChessEngine& game, int& wdl) const {
+	if(game.EP || game.CastleWK || game.CastleWQ || game.CastleBK || game.CastleBQ) {
+		return false;
+	}
+
+	const auto signature = MaterialSignature(game);
+	if(OnlyKings(signature)) {
+		wdl = 0;
+		return true;
+	}
+
+	bool flip;
+	const auto table = Find(signature, flip);
+	if(!table) {
+		return false;
+	}
+
+	switch(table->Get(table->Index(game, flip))) {
+		case Bitbase::Win: wdl = 1; return true;
+		case Bitbase::Loss: wdl = -1; return true;
+		case Bitbase::Draw: wdl = 0; return true;
+		default: return false;
+	}
+}
+
+// Flags every position of the same material set that reaches this one with a quiet move
+static void MarkPredecessors(const Bitbase& table, uint64_t index, std::vector<uint8_t>& dirty) {
+	const int count = table.Pieces.size() + 2;
+	int squares[4];
+	for(int i = count - 1; i >= 0; i--) {
+		squares[i] = index & 63;
+		index >>= 6;
+	}
+
+	const int mover = index ^ 1;
+	uint64_t occupied = 0;
+	for(int i = 0; i < count; i++) {
+		occupied |= 1ULL << squares[i];
+	}
+
+	for(int i = 0; i < count; i++) {
+		const auto color = i < 2 ? i : table.Pieces[i - 2].Color;
+		if(color != mover) continue;
+
+		const auto square = squares[i];
+		const auto bit = 1ULL << square;
+		uint64_t origins = 0;
+
+		if(i < 2) {
+			origins = KingMoves[square];
+		} else {
+			switch(table.Pieces[i - 2].Type) {
+				case 0:
+					if(mover == 0) {
+						origins = (bit >> 8) & ~Rank1;
+						if((bit & Rank4) && !((bit >> 8) & occupied)) origins |= bit >> 16;
+					} else {
+						origins = (bit << 8) & ~Rank8;
+						if((bit & Rank5) && !((bit << 8) & occupied)) origins |= bit << 16;
+					}
+					break;
+				case 1: origins = KnightMoves[square]; break;
+				case 2: origins = DiagMask(square, occupied); break;
+				case 3: origins = StraightMask(square, occupied); break;
+				case 4: origins = DiagMask(square, occupied) | StraightMask(square, occupied); break;
+			}
+		}
+		origins &= ~occupied;
+
+		uint64_t rest = (uint64_t)mover << (6 * count);
+		for(int j = 0; j < count; j++) {
+			if(j != i) rest |= (uint64_t)squares[j] << (6 * (count - 1 - j));
+		}
+
+		while(origins) {
+			const uint64_t from = NumberOfTrailingZeros(origins);
+			std::atomic_ref<uint8_t>(dirty[rest | from << (6 * (count - 1 - i))]).store(1, std::memory_order_relaxed);
+			origins &= origins - 1;
+		}
+	}
+}
+
+void Bitbases::Build(Bitbase& table) const {
+	const int64_t size = table.Size();
+	std::vector<uint8_t> state(size, Unknown);
+
+	// Retrograde analysis by repeated sweeps: a position is won if a move reaches a lost position,
+	// lost if every move reaches a won one. Whatever is still unknown once nothing changes is a draw.
+	// After the first sweep only the predecessors of positions resolved in the previous sweep are revisited.
+	auto resolve = [&](uint64_t index) -> uint8_t {
+		ChessEngine game;
+		if(!Decode(table, index, game)) {
+			return Bitbase::Illegal;
+		}
+
+		bool any = false;
+		bool allWin = true;
+		bool unknown = false;
+
+		for(const auto move : game.GetMoves()) {
+			auto cp = game;
+			cp.MakeMove(move);
+			if(!cp.IsValid()) continue;
+
+			any = true;
+
+			uint8_t value;
+			if(MaterialSignature(cp) == table.Signature) {
+				value = std::atomic_ref<uint8_t>(state[table.Index(cp, false)]).load(std::memory_order_relaxed);
+			} else {
+				value = Lookup(cp);
+			}
+
+			if(value == Bitbase::Loss) return Bitbase::Win;
+			if(value != Bitbase::Win) allWin = false;
+			if(value == Unknown) unknown = true;
+		}
+
+		if(!any) {
+			return game.IsCheck() ? Bitbase::Loss : Bitbase::Draw;
+		}
+		if(allWin) return Bitbase::Loss;
+		if(!unknown) return Bitbase::Draw;
+		return Unknown;
+	};
+
+	std::vector<uint8_t> dirty(size, 1);
+	std::vector<uint8_t> next(size, 0);
+	bool changed = true;
+	int passes = 0;
+
+	while(changed) {
+		changed = false;
+		passes++;
+
+#pragma omp parallel for schedule(dynamic, 4096) reduction(||:changed)
+		for(int64_t i = 0; i < size; i++) {
+			if(!dirty[i]) continue;
+
+			std::atomic_ref<uint8_t> current(state[i]);
+			if(current.load(std::memory_order_relaxed) != Unknown) continue;
+
+			const auto value = resolve(i);
+			if(value != Unknown) {
+				current.store(value, std::memory_order_relaxed);
+				MarkPredecessors(table, i, next);
+				changed = true;
+			}
+		}
+
+		dirty.swap(next);
+		std::fill(next.begin(), next.end(), 0);
+	}
+
+	table.owned.assign(size / 4, 0);
+	for(int64_t i = 0; i < size; i++) {
+		const auto value = state[i] == Unknown ? Bitbase::Draw : state[i];
+		table.owned[i >> 2] |= value << ((i & 3) * 2);
+	}
+	table.data = table.owned.data();
+
+	std::cout << table.Name << ": " << size << " positions in " << passes << " passes" << std::endl;
+}
+
+void Bitbases::Load(const std::string& directory) {
+	for(const auto& entry : std::filesystem::directory_iterator(directory)) {
+		if(entry.path().extension() != ".bb") continue;
+
+		const auto name = entry.path().stem().string();
+		bool flip;
+		if(Find(Bitbase(name).Signature, flip)) continue;
+
+		tables.push_back(std::make_unique<Bitbase>(name, entry.path().string()));
+	}
+}
+
+void Bitbases::Generate(const std::string& directory, const std::string& name) {
+	auto table = std::make_unique<Bitbase>(name);
+
+	bool flip;
+	if(Find(table->Signature, flip)) return;
+
+	for(const auto dependency : Dependencies(table->Signature)) {
+		if(OnlyKings(dependency) || Find(dependency, flip)) continue;
+		Generate(directory, CanonicalName(dependency));
+	}
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	Build(*table);
+	auto passed = std::chrono::duration_cast<std::chrono::duration<float>>(std::chrono::high_resolution_clock::now() - begin).count();
+	std::cout << table->Name << ": generated in " << passed << "s" << std::endl;
+
+	std::filesystem::create_directories(directory);
+	table->Save((std::filesystem::path(directory) / (name + ".bb")).string());
+	tables.push_back(std::move(table));
+}
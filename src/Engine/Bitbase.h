@@ -0,0 +1,69 @@
+#pragma once
+#include "ChessEngine.h"
+#include "MappedFile.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Win/draw/loss table for one material set like "KRK" or "KQKR", white is the first side in the name.
+// Positions are indexed by side to move and the square of every piece, en passant and castling are ignored.
+class Bitbase {
+public:
+	enum Value : uint8_t {
+		Draw,
+		Win,
+		Loss,
+		Illegal
+	};
+
+	struct PieceInfo {
+		int Type; // P, N, B, R, Q
+		int Color; // 0 = white, 1 = black
+	};
+
+	std::string Name;
+	uint64_t Signature;
+	std::vector<PieceInfo> Pieces; // without kings
+
+	Bitbase(const std::string& name);
+	Bitbase(const std::string& name, const std::string& path);
+
+	uint64_t Size() const { return 2ULL << (6 * (Pieces.size() + 2)); }
+
+	// flip mirrors the board and swaps the colors
+	uint64_t Index(const ChessEngine& game, bool flip) const;
+
+	Value Get(uint64_t index) const {
+		return (Value)((data[index >> 2] >> ((index & 3) * 2)) & 3);
+	}
+
+	void Save(const std::string& path) const;
+private:
+	const uint8_t* data = nullptr;
+	std::vector<uint8_t> owned;
+	std::unique_ptr<MappedFile> file;
+
+	friend class Bitbases;
+};
+
+class Bitbases {
+public:
+	// Maps every table in the directory
+	void Load(const std::string& directory);
+	// Generates the table and every table it depends on, then writes them to the directory
+	void Generate(const std::string& directory, const std::string& name);
+
+	// wdl is from the view of the side to move: 1 win, 0 draw, -1 loss
+	bool Probe(const ChessEngine& game, int& wdl) const;
+
+	size_t Count() const { return tables.size(); }
+private:
+	std::vector<std::unique_ptr<Bitbase>> tables;
+
+	const Bitbase* Find(uint64_t signature, bool& flip) const;
+	Bitbase::Value Lookup(const ChessEngine& game) const;
+	void Build(Bitbase& table) const;
+};
+
+uint64_t MaterialSignature(const ChessEngine& game);
@@ -0,0 +1,26 @@
+#pragma once
+#include "ChessEngine.h"
+#include "MappedFile.h"
+
+#include <random>
+#include <string>
+
+// Opening book in the Polyglot .bin format: 16 byte big endian entries sorted by position key
+class Book {
+public:
+	Book(const std::string& path);
+
+	// Picks a book move weighted by its count, returns a move with MoveType::Error if the position is not in the book
+	Move Probe(const ChessEngine& game);
+
+	size_t Size() const { return count; }
+
+	static uint64_t Key(const ChessEngine& game);
+
+	// Builds a book from a text file with one game per line given as moves in uci notation
+	static void Create(const std::string& gamesPath, const std::string& path, int maxPly);
+private:
+	MappedFile file;
+	size_t count;
+	std::mt19937_64 rng;
+};
@@ -1,10 +1,14 @@
 #include "ChessEngine.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <iostream>
 
 #include "ChessConstants.h"
+#include "Counters.h"
 #include "Magic.h"
+#include "Zobrist.h"
 #include "../Platform.h"
 
 static uint64_t Reverse(uint64_t i) {
@@ -161,14 +165,31 @@ ChessEngine::ChessEngine(const std::string fen) : White(0), Black(0), P(0), N(0)
 		i++;
 	}
 
-	// TODO other fen values
+	// halfmove clock and fullmove number are optional
+	std::istringstream counters(fen.substr(std::min(fen.size(), (size_t)i + 1)));
+	int halfMoves, fullMoves;
+	if(counters >> halfMoves >> fullMoves) {
+		HalfMoves = halfMoves;
+		FullMoves = fullMoves;
+	}
 
-	CalcTables();
+	Refresh();
 }
 
 void ChessEngine::MakeMove(Move m) {
+	Counters::MakeMove(m.Type);
+
+	const uint64_t before[6] = { P, N, B, R, Q, K };
+	const auto whiteBefore = White;
+	const auto blackBefore = Black;
+	const auto castleBefore = CastleFlags();
+	const auto epBefore = EP;
+
 	EP = 0;
 
+	const auto pawns = P;
+	const auto whitePawns = P & White;
+
 	auto start = 1ULL << (63 - (m.X0 + (m.Y0 << 3)));
 	auto end = 1ULL << (63 - (m.X1 + (m.Y1 << 3)));
 	auto moveMask = start | end;
@@ -330,8 +351,30 @@ void ChessEngine::MakeMove(Move m) {
 	}
 
 end: // TODO: remove goto
+	// a captured rook loses its castling right right away so the flags stay part of the key
+	if(end & 0x8100000000000081) {
+		if(end & 1) CastleWK = false;
+		if(end & 0x80) CastleWQ = false;
+		if(end & (1ULL << 56)) CastleBK = false;
+		if(end & (1ULL << 63)) CastleBQ = false;
+	}
+
+	if(P != pawns || (end & occupied)) {
+		HalfMoves = 0;
+	} else {
+		HalfMoves++;
+	}
+	if(!WhiteMove) {
+		FullMoves++;
+	}
+
 	WhiteMove = !WhiteMove;
 
+	if(P != pawns) {
+		UpdatePawnHash(whitePawns ^ (P & White), (pawns & ~whitePawns) ^ (P & Black));
+	}
+	UpdateHash(before, whiteBefore, blackBefore, castleBefore, epBefore);
+
 	// CalcTables();
 	occupied = P | N | B | R | Q | K;
 	revOccupied = Reverse(occupied);
@@ -404,6 +447,26 @@ void ChessEngine::print() const {
 	std::cout << *this << std::endl;
 }
 
+void ChessEngine::Refresh() {
+	CalcTables();
+
+	// drop castling rights whose king or rook is gone
+	if(!(White & K & (1ULL << 3))) CastleWK = CastleWQ = false;
+	if(!(Black & K & (1ULL << 59))) CastleBK = CastleBQ = false;
+	if(!(White & R & 1)) CastleWK = false;
+	if(!(White & R & 0x80)) CastleWQ = false;
+	if(!(Black & R & (1ULL << 56))) CastleBK = false;
+	if(!(Black & R & (1ULL << 63))) CastleBQ = false;
+
+	PawnHash = 0;
+	UpdatePawnHash(P & White, P & Black);
+
+	// hash everything as if it was added by a move from an empty board
+	const uint64_t none[6] = {};
+	Hash = WhiteMove ? Zobrist.BlackMove : 0;
+	UpdateHash(none, 0, 0, 0, 0);
+}
+
 void ChessEngine::CalcTables() {
 	occupied = P | N | B | R | Q | K;
 	revOccupied = Reverse(occupied);
@@ -413,8 +476,50 @@ void ChessEngine::CalcTables() {
 	unsafeForBlack = UnsafeForBlack();
 }
 
+int ChessEngine::CastleFlags() const {
+	return CastleWK | (CastleWQ << 1) | (CastleBK << 2) | (CastleBQ << 3);
+}
+
+void ChessEngine::UpdateHash(const uint64_t before[6], uint64_t whiteBefore, uint64_t blackBefore, int castleBefore, uint64_t epBefore) {
+	const uint64_t after[6] = { P, N, B, R, Q, K };
+
+	for(int type = 0; type < 6; type++) {
+		auto whiteDiff = (before[type] & whiteBefore) ^ (after[type] & White);
+		auto blackDiff = (before[type] & blackBefore) ^ (after[type] & Black);
+
+		while(whiteDiff) {
+			Hash ^= Zobrist.Pieces[type * 2][NumberOfTrailingZeros(whiteDiff)];
+			whiteDiff &= whiteDiff - 1;
+		}
+		while(blackDiff) {
+			Hash ^= Zobrist.Pieces[type * 2 + 1][NumberOfTrailingZeros(blackDiff)];
+			blackDiff &= blackDiff - 1;
+		}
+	}
+
+	Hash ^= Zobrist.Castle[castleBefore] ^ Zobrist.Castle[CastleFlags()] ^ Zobrist.BlackMove;
+
+	if(epBefore) Hash ^= Zobrist.EnPassant[7 - NumberOfTrailingZeros(epBefore) % 8];
+	if(EP) Hash ^= Zobrist.EnPassant[7 - NumberOfTrailingZeros(EP) % 8];
+}
+
+void ChessEngine::UpdatePawnHash(uint64_t whiteDiff, uint64_t blackDiff) {
+	while(whiteDiff) {
+		PawnHash ^= Zobrist.Pieces[(int)Piece::WhitePawn][NumberOfTrailingZeros(whiteDiff)];
+		whiteDiff &= whiteDiff - 1;
+	}
+	while(blackDiff) {
+		PawnHash ^= Zobrist.Pieces[(int)Piece::BlackPawn][NumberOfTrailingZeros(blackDiff)];
+		blackDiff &= blackDiff - 1;
+	}
+}
+
 bool ChessEngine::IsValid() const {
-	return WhiteMove ? !(unsafeForBlack & Black & K) : !(unsafeForWhite & White & K);
+	const bool valid = WhiteMove ? !(unsafeForBlack & Black & K) : !(unsafeForWhite & White & K);
+	if(!valid) {
+		Counters::Rejected();
+	}
+	return valid;
 }
 
 bool ChessEngine::IsCheck() const {
@@ -439,6 +544,231 @@ bool ChessEngine::IsCheckmate() {
 	return true;
 }
 
+bool ChessEngine::IsCapture(Move m) const {
+	const auto end = 1ULL << (63 - (m.X1 + (m.Y1 << 3)));
+	return (occupied & end) || m.Type == MoveType::WhiteEnPassant || m.Type == MoveType::BlackEnPassant;
+}
+
+uint64_t ChessEngine::AttackersTo(int square, uint64_t occupied) const {
+	const auto mask = 1ULL << square;
+
+	const auto whitePawns = ((mask >> 7) & ~FileH | (mask >> 9) & ~FileA) & White & P;
+	const auto blackPawns = ((mask << 7) & ~FileA | (mask << 9) & ~FileH) & Black & P;
+
+	return whitePawns | blackPawns |
+		(KnightMoves[square] & N) |
+		(KingMoves[square] & K) |
+		(DiagMask(square, occupied) & (B | Q)) |
+		(StraightMask(square, occupied) & (R | Q));
+}
+
+// P, N, B, R, Q, K
+static constexpr int SeeValues[] = { 100, 320, 330, 500, 900, 20000 };
+
+Move ChessEngine::ParseMove(std::string_view text) const {
+	if(text.size() < 4) {
+		throw std::logic_error("bad move format");
+	}
+
+	Move m(text[0] - 'a', 7 - (text[1] - '1'), text[2] - 'a', 7 - (text[3] - '1'), MoveType::Error);
+	if(m.X0 > 7 || m.Y0 > 7 || m.X1 > 7 || m.Y1 > 7) {
+		throw std::logic_error("bad move format");
+	}
+
+	if(text.size() >= 5) {
+		switch(text[4]) {
+			case 'n': m.Type = MoveType::PromotionN; return m;
+			case 'b': m.Type = MoveType::PromotionB; return m;
+			case 'r': m.Type = MoveType::PromotionR; return m;
+			case 'q': m.Type = MoveType::PromotionQ; return m;
+			default: throw std::logic_error("bad move format");
+		}
+	}
+
+	const auto end = 1ULL << (63 - (m.X1 + m.Y1 * 8));
+
+	switch(GetPiece(m.X0, m.Y0)) {
+		case Piece::WhitePawn:
+			m.Type = m.X0 != m.X1 && !(occupied & end) ? MoveType::WhiteEnPassant : MoveType::WhitePawn;
+			break;
+		case Piece::BlackPawn:
+			m.Type = m.X0 != m.X1 && !(occupied & end) ? MoveType::BlackEnPassant : MoveType::BlackPawn;
+			break;
+		case Piece::WhiteKnight:
+		case Piece::BlackKnight:
+			m.Type = MoveType::Knight;
+			break;
+		case Piece::WhiteBishop:
+		case Piece::BlackBishop:
+			m.Type = MoveType::Bishop;
+			break;
+		case Piece::WhiteQueen:
+		case Piece::BlackQueen:
+			m.Type = MoveType::Queen;
+			break;
+		case Piece::WhiteRook:
+			m.Type = MoveType::WhiteRook;
+			break;
+		case Piece::BlackRook:
+			m.Type = MoveType::BlackRook;
+			break;
+		case Piece::WhiteKing:
+			m.Type = std::abs(m.X0 - m.X1) == 2 ? MoveType::WhiteCastle : MoveType::WhiteKing;
+			break;
+		case Piece::BlackKing:
+			m.Type = std::abs(m.X0 - m.X1) == 2 ? MoveType::BlackCastle : MoveType::BlackKing;
+			break;
+		default:
+			throw std::logic_error("no piece to move");
+	}
+
+	return m;
+}
+
+std::string ChessEngine::Fen() const {
+	std::string fen;
+
+	for(int rank = 7; rank >= 0; rank--) {
+		int empty = 0;
+		for(int file = 0; file < 8; file++) {
+			const auto mask = 1ULL << (rank * 8 + 7 - file);
+
+			char c = 0;
+			if(P & mask) c = 'p';
+			else if(N & mask) c = 'n';
+			else if(B & mask) c = 'b';
+			else if(R & mask) c = 'r';
+			else if(Q & mask) c = 'q';
+			else if(K & mask) c = 'k';
+
+			if(!c) {
+				empty++;
+				continue;
+			}
+			if(empty) {
+				fen += char('0' + empty);
+				empty = 0;
+			}
+			fen += (White & mask) ? char(c - 'a' + 'A') : c;
+		}
+
+		if(empty) fen += char('0' + empty);
+		if(rank) fen += '/';
+	}
+
+	fen += WhiteMove ? " w " : " b ";
+
+	if(CastleWK) fen += 'K';
+	if(CastleWQ) fen += 'Q';
+	if(CastleBK) fen += 'k';
+	if(CastleBQ) fen += 'q';
+	if(!(CastleWK || CastleWQ || CastleBK || CastleBQ)) fen += '-';
+
+	// EP holds the pawn that just moved two squares, the fen names the square behind it
+	if(EP) {
+		const auto square = NumberOfTrailingZeros(EP);
+		fen += ' ';
+		fen += char('a' + 7 - square % 8);
+		fen += square / 8 == 3 ? '3' : '6';
+	} else {
+		fen += " -";
+	}
+
+	return fen + " " + std::to_string(HalfMoves) + " " + std::to_string(FullMoves);
+}
+
+int ChessEngine::SEE(Move m) const {
+	const int from = 63 - (m.X0 + (m.Y0 << 3));
+	const int to = 63 - (m.X1 + (m.Y1 << 3));
+	const auto end = 1ULL << to;
+
+	int gain[32];
+	int attacker;
+	auto occ = occupied ^ (1ULL << from);
+
+	const uint64_t boards[] = { P, N, B, R, Q, K };
+
+	gain[0] = 0;
+	for(int i = 0; i < 5; i++) {
+		if(boards[i] & end) {
+			gain[0] = SeeValues[i];
+			break;
+		}
+	}
+
+	switch(m.Type) {
+		case MoveType::Knight: attacker = 1; break;
+		case MoveType::Bishop: attacker = 2; break;
+		case MoveType::Queen: attacker = 4; break;
+		case MoveType::WhiteRook:
+		case MoveType::BlackRook: attacker = 3; break;
+		case MoveType::WhiteKing:
+		case MoveType::BlackKing: attacker = 5; break;
+		case MoveType::WhitePawn:
+		case MoveType::BlackPawn: attacker = 0; break;
+		case MoveType::WhiteEnPassant:
+		case MoveType::BlackEnPassant:
+			attacker = 0;
+			gain[0] = SeeValues[0];
+			occ ^= 1ULL << (63 - (m.X1 + (m.Y0 << 3)));
+			break;
+		case MoveType::PromotionN: attacker = 1; break;
+		case MoveType::PromotionB: attacker = 2; break;
+		case MoveType::PromotionR: attacker = 3; break;
+		case MoveType::PromotionQ: attacker = 4; break;
+		default:
+			return 0; // castling can't capture anything
+	}
+
+	if(m.Type >= MoveType::PromotionN && m.Type <= MoveType::PromotionQ) {
+		gain[0] += SeeValues[attacker] - SeeValues[0];
+	}
+
+	const auto diagSliders = B | Q;
+	const auto straightSliders = R | Q;
+
+	auto attackers = AttackersTo(to, occ) & occ;
+	auto side = WhiteMove ? Black : White;
+	int d = 0;
+
+	while(true) {
+		const auto mine = attackers & side;
+		if(!mine) break;
+
+		// least valuable attacker
+		int type = 0;
+		uint64_t bit = 0;
+		for(; type < 6; type++) {
+			const auto b = mine & boards[type];
+			if(b) {
+				bit = b & ~(b - 1);
+				break;
+			}
+		}
+
+		d++;
+		gain[d] = SeeValues[attacker] - gain[d - 1];
+		if(std::max(-gain[d - 1], gain[d]) < 0) break;
+
+		occ ^= bit;
+
+		// uncover x-ray attackers behind the piece that just captured
+		if(type == 0 || type == 2 || type == 4) attackers |= DiagMask(to, occ) & diagSliders;
+		if(type == 3 || type == 4) attackers |= StraightMask(to, occ) & straightSliders;
+		attackers &= occ;
+
+		attacker = type;
+		side = side == White ? Black : White;
+	}
+
+	while(d) {
+		gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+		d--;
+	}
+
+	return gain[0];
+}
+
 Test ChessEngine::GetMoves() {
 	Test moves;
 	if(WhiteMove) {
@@ -463,6 +793,7 @@ Test ChessEngine::GetMoves() {
 		PossibleBC(moves);
 	}
 
+	Counters::GetMoves(moves.size());
 	return moves;
 }
 
@@ -932,6 +1263,7 @@ void ChessEngine::PossibleBP(Test& moves) const {
 
 	#pragma region Promote by Attack top left
 	mask = (BP >> 9) & whitePieces & ~FileA & Rank1;
+	poss = mask & ~(mask - 1);
 	while(poss != 0) {
 		int i = NumberOfTrailingZeros(poss);
 
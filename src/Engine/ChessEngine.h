@@ -3,6 +3,7 @@
 #include "Move.h"
 
 #include <string>
+#include <string_view>
 #include <array>
 #include <optional>
 
@@ -143,6 +144,15 @@ public:
 	uint64_t P, N, R, B, Q, K;
 	uint64_t EP;
 
+	// Zobrist key of the pawn placement only
+	uint64_t PawnHash = 0;
+	// Zobrist key of the whole position
+	uint64_t Hash = 0;
+
+	// Plies since the last capture or pawn move
+	int HalfMoves = 0;
+	int FullMoves = 1;
+
 	// Temporary vars
 	uint64_t unsafeForWhite, unsafeForBlack;
 	uint64_t occupied, revOccupied, empty;
@@ -152,13 +162,29 @@ public:
 
 	void MakeMove(Move m);
 
+	// Recomputes the attack tables and keys after the bitboards were changed directly
+	void Refresh();
+
 	bool IsValid() const;
 	bool IsCheck() const;
 	bool IsCheckmate();
+	bool IsCapture(Move m) const;
+
+	// Move in uci notation like e2e4 or a7a8q, the type follows from the piece on the start square
+	Move ParseMove(std::string_view text) const;
+	// Position in Forsyth-Edwards notation, the inverse of the fen constructor
+	std::string Fen() const;
+
+	// Static exchange evaluation of the material balance after all captures on the target square
+	int SEE(Move m) const;
 
 	Test GetMoves();
 	Test GetValidMoves();
 
+	// Squares attacked by the other side
+	uint64_t UnsafeForBlack() const;
+	uint64_t UnsafeForWhite() const;
+
 	Piece GetPiece(int position) const;
 	Piece GetPiece(int column, int row) const;
 
@@ -167,8 +193,10 @@ public:
 	friend std::ostream& operator<<(std::ostream& stream, const ChessEngine& game);
 private:
 	void CalcTables();
-	uint64_t UnsafeForBlack() const;
-	uint64_t UnsafeForWhite() const;
+	uint64_t AttackersTo(int square, uint64_t occupied) const;
+	void UpdatePawnHash(uint64_t whiteDiff, uint64_t blackDiff);
+	void UpdateHash(const uint64_t before[6], uint64_t whiteBefore, uint64_t blackBefore, int castleBefore, uint64_t epBefore);
+	int CastleFlags() const;
 
 	void PossibleWP(Test& moves) const;
 	void PossibleBP(Test& moves) const;
@@ -0,0 +1,101 @@
+#include "Counters.h"
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+static const char* MoveTypeNames[] = {
+	"Error", "Knight", "Bishop", "Queen",
+	"PromotionN", "PromotionR", "PromotionB", "PromotionQ",
+	"WhitePawn", "WhiteEnPassant", "WhiteRook", "WhiteKing", "WhiteCastle",
+	"BlackPawn", "BlackEnPassant", "BlackRook", "BlackKing", "BlackCastle"
+};
+static_assert(std::size(MoveTypeNames) == Counters::MoveTypes);
+
+// blocks of finished threads stay so their counts are still part of the total
+static std::mutex mutex;
+static std::vector<std::unique_ptr<Counters::Block>> blocks;
+
+void Counters::Block::operator+=(const Block& other) {
+	for(int i = 0; i < MoveTypes; i++) {
+		MakeMove[i] += other.MakeMove[i];
+	}
+	GetMoves += other.GetMoves;
+	GeneratedMoves += other.GeneratedMoves;
+	Rejected += other.Rejected;
+	Evals += other.Evals;
+	for(int i = 0; i < CutoffSlots; i++) {
+		Cutoffs[i] += other.Cutoffs[i];
+	}
+	MainNodes += other.MainNodes;
+	QuiescenceNodes += other.QuiescenceNodes;
+}
+
+Counters::Block& Counters::Register() {
+	std::lock_guard lock(mutex);
+	blocks.push_back(std::make_unique<Block>());
+	return *blocks.back();
+}
+
+Counters::Block Counters::Total() {
+	std::lock_guard lock(mutex);
+	Block total;
+	for(const auto& block : blocks) {
+		total += *block;
+	}
+	return total;
+}
+
+void Counters::Reset() {
+	std::lock_guard lock(mutex);
+	for(auto& block : blocks) {
+		*block = {};
+	}
+}
+
+static double Percent(uint64_t part, uint64_t total) {
+	return total ? part * 100.0 / total : 0;
+}
+
+std::string Counters::Report() {
+	if(!Enabled) {
+		return "counters disabled, build with -DENGINE_COUNTERS=ON\n";
+	}
+
+	const auto total = Total();
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(2);
+
+	uint64_t makeMoves = 0;
+	for(auto count : total.MakeMove) {
+		makeMoves += count;
+	}
+	out << "MakeMove " << makeMoves << "\n";
+	for(int i = 0; i < MoveTypes; i++) {
+		if(total.MakeMove[i]) {
+			out << "  " << MoveTypeNames[i] << " " << total.MakeMove[i] << " (" << Percent(total.MakeMove[i], makeMoves) << "%)\n";
+		}
+	}
+
+	out << "GetMoves " << total.GetMoves << " calls, " << (total.GetMoves ? (double)total.GeneratedMoves / total.GetMoves : 0) << " moves per call\n";
+	out << "IsValid rejections " << total.Rejected << "\n";
+	out << "Eval calls " << total.Evals << "\n";
+
+	const auto nodes = total.MainNodes + total.QuiescenceNodes;
+	out << "Nodes main " << total.MainNodes << ", quiescence " << total.QuiescenceNodes << " (" << Percent(total.QuiescenceNodes, nodes) << "%)\n";
+
+	uint64_t cutoffs = 0;
+	for(auto count : total.Cutoffs) {
+		cutoffs += count;
+	}
+	out << "Beta cutoffs " << cutoffs << "\n";
+	for(int i = 0; i < CutoffSlots; i++) {
+		if(total.Cutoffs[i]) {
+			out << "  move " << i + 1 << (i == CutoffSlots - 1 ? "+" : "") << " " << total.Cutoffs[i] << " (" << Percent(total.Cutoffs[i], cutoffs) << "%)\n";
+		}
+	}
+
+	return out.str();
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "Move.h"
+
+#include <cstdint>
+#include <string>
+
+// Enabled with cmake -DENGINE_COUNTERS=ON, otherwise every call below compiles to nothing
+#ifndef ENGINE_COUNTERS
+#define ENGINE_COUNTERS 0
+#endif
+
+// Hot path event counts of the move generator and the search
+namespace Counters {
+	constexpr bool Enabled = ENGINE_COUNTERS;
+
+	constexpr int MoveTypes = (int)MoveType::BlackCastle + 1;
+	// cutoffs at later moves share the last slot
+	constexpr int CutoffSlots = 16;
+
+	// One block per thread, aligned to cache lines so the threads never write to the same line
+	struct alignas(64) Block {
+		uint64_t MakeMove[MoveTypes] = {};
+		uint64_t GetMoves = 0;
+		uint64_t GeneratedMoves = 0;
+		uint64_t Rejected = 0;
+		uint64_t Evals = 0;
+		uint64_t Cutoffs[CutoffSlots] = {};
+		uint64_t MainNodes = 0;
+		uint64_t QuiescenceNodes = 0;
+
+		void operator +=(const Block& other);
+	};
+
+	// Creates the block of the calling thread
+	Block& Register();
+
+	inline Block& Local() {
+		thread_local Block& block = Register();
+		return block;
+	}
+
+	inline void MakeMove(MoveType type) {
+		if constexpr(Enabled) Local().MakeMove[(int)type]++;
+	}
+	inline void GetMoves(int count) {
+		if constexpr(Enabled) {
+			auto& block = Local();
+			block.GetMoves++;
+			block.GeneratedMoves += count;
+		}
+	}
+	inline void Rejected() {
+		if constexpr(Enabled) Local().Rejected++;
+	}
+	inline void Eval() {
+		if constexpr(Enabled) Local().Evals++;
+	}
+	// index of the legal move that failed high, 0 is the first one searched
+	inline void Cutoff(int index) {
+		if constexpr(Enabled) Local().Cutoffs[index < CutoffSlots ? index : CutoffSlots - 1]++;
+	}
+	inline void MainNode() {
+		if constexpr(Enabled) Local().MainNodes++;
+	}
+	inline void QuiescenceNode() {
+		if constexpr(Enabled) Local().QuiescenceNodes++;
+	}
+
+	// Sum over all threads
+	Block Total();
+	void Reset();
+
+	// Readable summary of Total(), one line per entry
+	std::string Report();
+}
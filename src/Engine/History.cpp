@@ -0,0 +1,46 @@
+#include "History.h"
+
+#include <algorithm>
+
+void History::Clear() {
+	entries.clear();
+	counts.fill(0);
+}
+
+void History::Push(const ChessEngine& game) {
+	entries.push_back({ game.Hash, game.HalfMoves });
+	counts[game.Hash % counts.size()]++;
+}
+
+void History::Pop() {
+	counts[entries.back().Key % counts.size()]--;
+	entries.pop_back();
+}
+
+bool History::IsRepetition(size_t root) const {
+	if(entries.empty()) return false;
+
+	const auto& current = entries.back();
+	if(counts[current.Key % counts.size()] < 2) {
+		return false;
+	}
+
+	// only positions since the last capture or pawn move can repeat, with the same side to move
+	const auto last = (int)entries.size() - 1;
+	const auto first = std::max(0, last - current.HalfMoves);
+
+	int count = 0;
+	for(int i = last - 4; i >= first; i -= 2) {
+		if(entries[i].Key == current.Key) {
+			if(i >= (int)root || ++count == 2) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool History::IsDraw() const {
+	return (!entries.empty() && entries.back().HalfMoves >= 100) || IsRepetition(entries.size());
+}
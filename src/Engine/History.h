@@ -0,0 +1,30 @@
+#pragma once
+#include "ChessEngine.h"
+
+#include <array>
+#include <vector>
+
+// Keys of every position of the game so far, the current position is the last one
+class History {
+public:
+	void Clear();
+	void Push(const ChessEngine& game);
+	void Pop();
+
+	size_t Size() const { return entries.size(); }
+
+	// Repeating a position at or after root counts right away, earlier positions need to occur twice
+	bool IsRepetition(size_t root) const;
+
+	// Threefold repetition or fifty move rule
+	bool IsDraw() const;
+private:
+	struct Entry {
+		uint64_t Key;
+		int HalfMoves;
+	};
+
+	std::vector<Entry> entries;
+	// number of entries per key bucket, most positions never need a scan
+	std::array<uint16_t, 4096> counts{};
+};
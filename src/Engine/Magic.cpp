@@ -1,6 +1,7 @@
 #include "Magic.h"
 #include "Platform.h"
 
+#include <cstring>
 #include <random>
 
 const int BitTable[64] = {
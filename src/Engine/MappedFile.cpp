@@ -0,0 +1,106 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#if _WIN32 || _WIN64
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if _WIN32 || _WIN64
+
+MappedFile::MappedFile(const std::string& path) {
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Can't open " + path);
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	size = fileSize.QuadPart;
+
+	if(size != 0) {
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if(!mapping) {
+			CloseHandle(file);
+			throw std::runtime_error("Can't map " + path);
+		}
+		data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+}
+
+MappedFile::MappedFile(const std::string& path, size_t size) : size(size) {
+	file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Can't create " + path);
+	}
+
+	if(size != 0) {
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+		if(!mapping) {
+			CloseHandle(file);
+			throw std::runtime_error("Can't map " + path);
+		}
+		data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+	}
+}
+
+MappedFile::~MappedFile() {
+	if(data) UnmapViewOfFile(data);
+	if(mapping) CloseHandle(mapping);
+	CloseHandle(file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+	fd = open(path.c_str(), O_RDONLY);
+	if(fd == -1) {
+		throw std::runtime_error("Can't open " + path);
+	}
+
+	struct stat info;
+	fstat(fd, &info);
+	size = info.st_size;
+
+	if(size != 0) {
+		auto ptr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		if(ptr == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Can't map " + path);
+		}
+		data = (uint8_t*)ptr;
+	}
+}
+
+MappedFile::MappedFile(const std::string& path, size_t size) : size(size) {
+	fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd == -1) {
+		throw std::runtime_error("Can't create " + path);
+	}
+
+	if(size != 0) {
+		if(ftruncate(fd, size) != 0) {
+			close(fd);
+			throw std::runtime_error("Can't resize " + path);
+		}
+
+		auto ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if(ptr == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Can't map " + path);
+		}
+		data = (uint8_t*)ptr;
+	}
+}
+
+MappedFile::~MappedFile() {
+	if(data) munmap((void*)data, size);
+	close(fd);
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Memory mapping of a whole file
+class MappedFile {
+public:
+	// Maps an existing file read only
+	MappedFile(const std::string& path);
+	// Creates or truncates the file to size bytes and maps it writable
+	MappedFile(const std::string& path, size_t size);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* Data() const { return data; }
+	// Only for files created writable
+	uint8_t* MutableData() { return data; }
+	size_t Size() const { return size; }
+private:
+	uint8_t* data = nullptr;
+	size_t size = 0;
+
+#if _WIN32 || _WIN64
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
@@ -60,10 +60,10 @@ inline std::ostream& operator<<(std::ostream& strm, const Move& m) {
 	strm << char('a' + m.X0) << (8 - m.Y0) << char('a' + m.X1) << (8 - m.Y1);
 
 	switch(m.Type) {
-		case MoveType::PromotionN: strm << "N"; break;
-		case MoveType::PromotionB: strm << "B"; break;
-		case MoveType::PromotionQ: strm << "Q"; break;
-		case MoveType::PromotionR: strm << "R"; break;
+		case MoveType::PromotionN: strm << "n"; break;
+		case MoveType::PromotionB: strm << "b"; break;
+		case MoveType::PromotionQ: strm << "q"; break;
+		case MoveType::PromotionR: strm << "r"; break;
 	}
 
 	return strm;
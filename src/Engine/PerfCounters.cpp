@@ -0,0 +1,147 @@
+#include "PerfCounters.h"
+
+#include <iomanip>
+#include <iostream>
+#include <omp.h>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* EventNames[] = { "cycles", "instructions", "branch misses", "L1d misses", "LLC misses", "dTLB misses" };
+
+#ifdef __linux__
+static constexpr uint64_t CacheMiss(uint64_t cache) {
+	return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static const std::pair<uint32_t, uint64_t> EventConfigs[] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	{ PERF_TYPE_HW_CACHE, CacheMiss(PERF_COUNT_HW_CACHE_L1D) },
+	{ PERF_TYPE_HW_CACHE, CacheMiss(PERF_COUNT_HW_CACHE_LL) },
+	{ PERF_TYPE_HW_CACHE, CacheMiss(PERF_COUNT_HW_CACHE_DTLB) },
+};
+
+// counts only the calling thread
+static int Open(PerfCounters::Event event) {
+	perf_event_attr attr{};
+	attr.size = sizeof(attr);
+	attr.type = EventConfigs[event].first;
+	attr.config = EventConfigs[event].second;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// more events than hardware counters get multiplexed, the times allow scaling them back up
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+PerfCounters::~PerfCounters() {
+	Close();
+}
+
+void PerfCounters::Close() {
+#ifdef __linux__
+	for(auto& thread : fds) {
+		for(auto fd : thread) {
+			if(fd >= 0) close(fd);
+		}
+	}
+#endif
+	fds.clear();
+}
+
+void PerfCounters::Start() {
+	Close();
+	available = false;
+
+#ifdef __linux__
+	fds.resize(omp_get_max_threads());
+	int opened = 0, failure = 0;
+
+	// every thread of the pool opens its own counters so work done by any of them is counted
+#pragma omp parallel reduction(+:opened) reduction(max:failure)
+	{
+		auto& thread = fds[omp_get_thread_num()];
+		for(int i = 0; i < EventCount; i++) {
+			thread[i] = Open((Event)i);
+			if(thread[i] >= 0) {
+				opened++;
+			} else {
+				failure = errno;
+			}
+		}
+	}
+
+	if(!opened) {
+		error = std::strerror(failure);
+		fds.clear();
+		return;
+	}
+	available = true;
+
+	for(auto& thread : fds) {
+		for(auto fd : thread) {
+			if(fd < 0) continue;
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#else
+	error = "only supported on Linux";
+#endif
+}
+
+PerfCounters::Values PerfCounters::Stop() {
+	Values values;
+
+#ifdef __linux__
+	for(auto& thread : fds) {
+		for(int i = 0; i < EventCount; i++) {
+			if(thread[i] < 0) continue;
+			ioctl(thread[i], PERF_EVENT_IOC_DISABLE, 0);
+
+			uint64_t data[3]; // value, time enabled, time running
+			if(read(thread[i], data, sizeof(data)) != sizeof(data)) continue;
+
+			values.Valid[i] = true;
+			if(data[2]) {
+				values.Counts[i] += (uint64_t)(data[0] * ((double)data[1] / data[2]));
+			}
+		}
+	}
+#endif
+
+	Close();
+	return values;
+}
+
+void PerfCounters::Print(const Values& values, uint64_t nodes) {
+	nodes = std::max<uint64_t>(nodes, 1);
+
+	std::cout << std::left << std::setw(16) << "counter" << std::right << std::setw(16) << "total" << std::setw(12) << "per node" << "\n";
+	std::cout << std::fixed << std::setprecision(3);
+
+	for(int i = 0; i < EventCount; i++) {
+		std::cout << std::left << std::setw(16) << EventNames[i] << std::right;
+		if(values.Valid[i]) {
+			std::cout << std::setw(16) << values.Counts[i] << std::setw(12) << (double)values.Counts[i] / nodes << "\n";
+		} else {
+			std::cout << std::setw(16) << "n/a" << "\n";
+		}
+	}
+
+	if(values.Valid[Cycles] && values.Valid[Instructions] && values.Counts[Cycles]) {
+		std::cout << "IPC: " << (double)values.Counts[Instructions] / values.Counts[Cycles] << "\n";
+	}
+	std::cout << std::defaultfloat << std::flush;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Hardware counters from perf_event_open, counted on every OpenMP thread between Start and Stop.
+// Only Linux is supported, elsewhere or without permission Available() stays false
+class PerfCounters {
+public:
+	enum Event {
+		Cycles,
+		Instructions,
+		BranchMisses,
+		L1Misses,
+		LlcMisses,
+		DtlbMisses,
+		EventCount
+	};
+
+	struct Values {
+		std::array<uint64_t, EventCount> Counts{};
+		// events the cpu or kernel doesn't support stay invalid
+		std::array<bool, EventCount> Valid{};
+	};
+
+	~PerfCounters();
+
+	void Start();
+	Values Stop();
+
+	bool Available() const { return available; }
+	// Why the counters couldn't be opened
+	const std::string& Error() const { return error; }
+
+	// Totals and rates per node
+	static void Print(const Values& values, uint64_t nodes);
+private:
+	// file descriptors by thread and event, -1 when the event couldn't be opened
+	std::vector<std::array<int, EventCount>> fds;
+	bool available = false;
+	std::string error;
+
+	void Close();
+};
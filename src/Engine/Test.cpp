@@ -1,9 +1,18 @@
 #include "Test.h"
+#include "Book.h"
 #include "ChessEngine.h"
+#include "Counters.h"
+#include "PerfCounters.h"
+#include "Tournament.h"
 
 #include <chrono>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 static Testcase data[] = {
@@ -23,11 +32,24 @@ static Testcase data[] = {
 	{"8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527, "Stalemate & Checkmate"}
 };
 
+// Key test vectors from the Polyglot specification
+static const std::pair<const char*, uint64_t> bookKeys[] = {
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463B96181691FC9CULL},
+	{"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823C9B50FD114196ULL},
+	{"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756B94461C50FB0ULL},
+	{"rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662FAFB965DB29D4ULL},
+	{"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22A48B5A8E47FF78ULL},
+	{"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652A607CA3F242C1ULL},
+	{"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00FDD303C946BDD9ULL},
+	{"rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3C8123EA7B067637ULL},
+	{"rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5C3F9B829B279560ULL}
+};
+
 struct PerftDat {
-	uint32_t total = 0;
-	uint32_t valid = 0;
+	uint64_t total = 0;
+	uint64_t valid = 0;
 
-	uint32_t endStates = 0;
+	uint64_t endStates = 0;
 
 	void operator +=(const PerftDat& other) {
 		total += other.total;
@@ -67,32 +89,8 @@ static PerftDat Perft(ChessEngine g, int depth) {
 	return ret;
 }
 
-void MoveTest() {
-	for(auto testcase : data) {
-		auto g = ChessEngine(testcase.fen);
-
-		auto count = Perft(g, testcase.depth);
-
-		if(count.endStates != testcase.count) {
-			std::cout << "\033[31m[Failed] ";
-		} else {
-			std::cout << "\033[32m[Passed] ";
-		}
-		std::cout << testcase.name << " Acc: " << (count.valid / (float)count.total) * 100 << "%\n";
-	}
-
-	std::cout << "\033[0m";
-}
-
-void PerformanceTest(int depth) {
-	// auto g = ChessEngine("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
-	// auto g = ChessEngine("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8");
-	auto g = ChessEngine();
-	auto begin = std::chrono::high_resolution_clock::now();
-
-#if false
-	PerftDat sum = Perft(g, depth);
-#else
+// the first two plies are expanded serially and the boards after them split over the OpenMP threads
+static PerftDat ParallelPerft(ChessEngine g, int depth) {
 	PerftDat sum {};
 
 	std::vector<ChessEngine> boards;
@@ -130,12 +128,226 @@ void PerformanceTest(int depth) {
 #pragma omp critical
 		sum += sub;
 	}
+
+	return sum;
+}
+
+uint64_t PerftNodes(const ChessEngine& game, int depth) {
+	return ParallelPerft(game, depth).endStates;
+}
+
+void MoveTest() {
+	for(auto testcase : data) {
+		auto g = ChessEngine(testcase.fen);
+
+		auto count = Perft(g, testcase.depth);
+
+		if(count.endStates != testcase.count) {
+			std::cout << "\033[31m[Failed] ";
+		} else {
+			std::cout << "\033[32m[Passed] ";
+		}
+		std::cout << testcase.name << " Acc: " << (count.valid / (float)count.total) * 100 << "%\n";
+	}
+
+	std::cout << "\033[0m";
+}
+
+void BookTest() {
+	for(const auto& [fen, expected] : bookKeys) {
+		const auto key = Book::Key(ChessEngine(fen));
+
+		if(key != expected) {
+			std::cout << "\033[31m[Failed] ";
+		} else {
+			std::cout << "\033[32m[Passed] ";
+		}
+		std::cout << "Polyglot key " << fen << "\n";
+	}
+
+	std::cout << "\033[0m";
+}
+
+// Positions where the side to move has no move to give, every player passes so Play has to tell the endings apart
+static const std::tuple<const char*, int, GameEnd> gameEnds[] = {
+	{"rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3", -1, GameEnd::Checkmate},
+	{"6rk/5Npp/8/8/8/8/8/6K1 b - - 0 1", 1, GameEnd::Checkmate},
+	{"7k/5Q2/6K1/8/8/8/8/8 b - - 0 1", 0, GameEnd::Stalemate},
+	{"8/8/8/8/8/1q6/2k5/K7 w - - 0 1", 0, GameEnd::Stalemate},
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", -1, GameEnd::Forfeit}
+};
+
+void GameEndTest() {
+	Players::Player pass;
+
+	for(const auto& [fen, score, end] : gameEnds) {
+		const auto result = Play(pass, pass, {}, ChessEngine(fen));
+
+		if(result.Score != score || result.End != end) {
+			std::cout << "\033[31m[Failed] ";
+		} else {
+			std::cout << "\033[32m[Passed] ";
+		}
+		std::cout << GameEndName(end) << " " << fen << "\n";
+	}
+
+	std::cout << "\033[0m";
+}
+
+void PerformanceTest(int depth, bool counters) {
+	// auto g = ChessEngine("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+	// auto g = ChessEngine("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8");
+	auto g = ChessEngine();
+
+	Counters::Reset();
+	PerfCounters perf;
+	if(counters) {
+		perf.Start();
+	}
+	auto begin = std::chrono::high_resolution_clock::now();
+
+#if false
+	PerftDat sum = Perft(g, depth);
+#else
+	PerftDat sum = ParallelPerft(g, depth);
 #endif
 
 	auto end = std::chrono::high_resolution_clock::now();
+	const auto values = perf.Stop();
 	auto passed = std::chrono::duration_cast<std::chrono::duration<float>>(end - begin).count();
 
 	std::cout << "Evaluated " << sum.endStates << " moves in " << passed << "s = " << (int)(sum.endStates / passed) << "/s\n";
 	// std::cout << "Evaluated " << sum.total << " moves in " << passed << "s = " << (int)(sum.total / passed) << "/s\n";
 	std::cout << "Accuracy: " << (sum.valid / (float)sum.total) * 100 << "%" << std::endl;
+
+	if(counters) {
+		if(perf.Available()) {
+			PerfCounters::Print(values, sum.endStates);
+		} else {
+			std::cout << "Hardware counters unavailable: " << perf.Error() << std::endl;
+		}
+	}
+	if(Counters::Enabled) {
+		std::cout << Counters::Report() << std::flush;
+	}
+}
+
+struct SuiteEntry {
+	std::string fen;
+	// expected node count by depth, 0 when the line doesn't have it
+	uint64_t expected[8] = {};
+	int depth = 0;
+
+	uint64_t nodes = 0;
+	float time = 0;
+	int failed = 0; // first depth with the wrong count
+};
+
+// "<fen> ;D1 20 ;D2 400 ..."
+static bool ParseEpd(const std::string& line, SuiteEntry& entry) {
+	const auto split = line.find(';');
+	if(split == std::string::npos) {
+		return false;
+	}
+
+	entry.fen = line.substr(0, line.find_last_not_of(' ', split - 1) + 1);
+
+	std::istringstream fields(line.substr(split));
+	std::string field;
+	while(std::getline(fields, field, ';')) {
+		std::istringstream parts(field);
+		std::string name;
+		uint64_t count;
+		if(!(parts >> name >> count) || name.size() != 2 || name[0] != 'D' || name[1] < '1' || name[1] > '7') {
+			continue;
+		}
+
+		const auto depth = name[1] - '0';
+		entry.expected[depth] = count;
+		entry.depth = std::max(entry.depth, depth);
+	}
+	return entry.depth != 0;
+}
+
+void PerftSuite(const std::string& path, int maxDepth, const std::string& jsonPath) {
+	std::ifstream file(path);
+	if(!file.is_open()) {
+		throw std::runtime_error("Could not open " + path);
+	}
+
+	std::vector<SuiteEntry> entries;
+	std::string line;
+	while(std::getline(file, line)) {
+		SuiteEntry entry;
+		if(ParseEpd(line, entry)) {
+			entry.depth = std::min(entry.depth, maxDepth);
+			entries.push_back(entry);
+		}
+	}
+
+	auto begin = std::chrono::high_resolution_clock::now();
+
+	// positions differ a lot in size so they are handed out one at a time
+#pragma omp parallel for schedule(dynamic, 1)
+	for(int i = 0; i < entries.size(); i++) {
+		auto& entry = entries[i];
+		const auto g = ChessEngine(entry.fen);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for(int depth = 1; depth <= entry.depth; depth++) {
+			if(!entry.expected[depth]) continue;
+
+			const auto count = Perft(g, depth).endStates;
+			entry.nodes += count;
+
+			if(count != entry.expected[depth]) {
+				entry.failed = depth;
+				break;
+			}
+		}
+		entry.time = std::chrono::duration_cast<std::chrono::duration<float>>(std::chrono::high_resolution_clock::now() - start).count();
+
+#pragma omp critical
+		{
+			std::cout << (entry.failed ? "\033[31m[Failed] " : "\033[32m[Passed] ") << "#" << i + 1 << " " << entry.fen;
+			if(entry.failed) {
+				std::cout << " at depth " << entry.failed;
+			}
+			std::cout << " " << entry.nodes << " nodes " << (uint64_t)(entry.nodes / std::max(entry.time, 1e-6f)) << "/s\033[0m\n";
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	auto passed = std::chrono::duration_cast<std::chrono::duration<float>>(end - begin).count();
+
+	uint64_t nodes = 0;
+	int failed = 0;
+	for(const auto& entry : entries) {
+		nodes += entry.nodes;
+		failed += entry.failed != 0;
+	}
+
+	std::cout << entries.size() - failed << "/" << entries.size() << " passed\n";
+	std::cout << "Evaluated " << nodes << " moves in " << passed << "s = " << (uint64_t)(nodes / passed) << "/s" << std::endl;
+
+	if(jsonPath.empty()) {
+		return;
+	}
+
+	std::ofstream json(jsonPath);
+	json << "{\n"
+		<< "  \"positions\": " << entries.size() << ",\n"
+		<< "  \"failed\": " << failed << ",\n"
+		<< "  \"nodes\": " << nodes << ",\n"
+		<< "  \"time\": " << passed << ",\n"
+		<< "  \"nps\": " << (uint64_t)(nodes / passed) << ",\n"
+		<< "  \"results\": [\n";
+
+	for(size_t i = 0; i < entries.size(); i++) {
+		const auto& entry = entries[i];
+		json << "    { \"fen\": \"" << entry.fen << "\", \"depth\": " << entry.depth << ", \"failed\": " << entry.failed
+			<< ", \"nodes\": " << entry.nodes << ", \"time\": " << entry.time << ", \"nps\": " << (uint64_t)(entry.nodes / std::max(entry.time, 1e-6f)) << " }"
+			<< (i + 1 < entries.size() ? "," : "") << "\n";
+	}
+	json << "  ]\n}\n";
 }
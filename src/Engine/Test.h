@@ -1,6 +1,9 @@
 #pragma once
+#include <cstdint>
 #include <string>
 
+class ChessEngine;
+
 struct Testcase {
 	std::string fen;
 	int depth;
@@ -10,4 +13,13 @@ struct Testcase {
 
 void RunTests();
 void MoveTest();
-void PerformanceTest(int depth);
+// Checks Book::Key against the test vectors of the Polyglot specification
+void BookTest();
+// Plays out mates, stalemates and a forfeit and checks how Play scores them
+void GameEndTest();
+// counters adds hardware performance counters to the report
+void PerformanceTest(int depth, bool counters = false);
+// Leaf count of a perft from game, spread over the OpenMP threads, depth has to be at least 3
+uint64_t PerftNodes(const ChessEngine& game, int depth);
+// Runs every ";D<n> <count>" of an EPD file up to maxDepth, positions are spread over all cores
+void PerftSuite(const std::string& path, int maxDepth, const std::string& jsonPath);
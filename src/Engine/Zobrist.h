@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+
+constexpr uint64_t SplitMix64(uint64_t& state) {
+	uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+struct ZobristKeys {
+	// indexed by Piece and bit index
+	uint64_t Pieces[12][64]{};
+	// indexed by the 4 castling flags
+	uint64_t Castle[16]{};
+	// indexed by the file of the en passant pawn, a = 0
+	uint64_t EnPassant[8]{};
+	uint64_t BlackMove = 0;
+
+	constexpr ZobristKeys() {
+		uint64_t state = 0x5EED5EED5EED5EEDULL;
+
+		for(auto& piece : Pieces) {
+			for(auto& key : piece) {
+				key = SplitMix64(state);
+			}
+		}
+
+		// combinations of flags xor the keys of the single flags
+		uint64_t flags[4]{};
+		for(auto& key : flags) {
+			key = SplitMix64(state);
+		}
+		for(int i = 0; i < 16; i++) {
+			for(int j = 0; j < 4; j++) {
+				if(i & (1 << j)) Castle[i] ^= flags[j];
+			}
+		}
+
+		for(auto& key : EnPassant) {
+			key = SplitMix64(state);
+		}
+		BlackMove = SplitMix64(state);
+	}
+};
+
+const ZobristKeys Zobrist{};
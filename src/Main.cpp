@@ -1,11 +1,20 @@
 ﻿#include <algorithm>
+#include <filesystem>
 #include <iostream>
 #include <random>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include "AllPlayers.h"
+#include "Bench.h"
+#include "DataGen.h"
+#include "Tournament.h"
+#include "Tune.h"
+#include "Engine/Book.h"
 #include "Engine/ChessConstants.h"
 #include "Engine/ChessEngine.h"
+#include "Engine/Counters.h"
 #include "Engine/Test.h"
 
 #include "Engine/Magic.h"
@@ -33,102 +42,88 @@ static std::vector<std::string> split(const std::string& str, const std::string&
 	return tokens;
 }
 
-struct EloPlayer {
-	std::unique_ptr<Players::Player> Player;
+// The search thread writes info and bestmove while the input thread keeps answering
+static std::mutex outputMutex;
 
-	float Rating = 1000;
-	int Wins = 0;
-	int Games = 0;
-};
-
-template<class T, class... Types>
-EloPlayer makeElo(Types&&... args) {
-	return EloPlayer{ std::make_unique<T>(std::forward<Types>(args)...) };
+static void Send(const std::string& message) {
+	std::lock_guard lock(outputMutex);
+	std::cout << message << std::endl;
 }
 
-int Play(EloPlayer& white, EloPlayer& black) {
-	auto game = ChessEngine();
-
-	int count = 0;
-
-	while(true) {
-		if(count > 200) {
-			break;
-		}
-
-		auto move = (game.WhiteMove ? white : black).Player->MakeMove(game);
-		if(move.Type == MoveType::Error) {
-			break; // no moves left
-		}
-		game.MakeMove(move);
-		count++;
+static std::shared_ptr<const Nnue::Network> LoadNetwork(const std::string& path) {
+	if(path.empty() || path == "<empty>") {
+		return std::make_shared<Nnue::Network>();
 	}
 
-	// white->Games++;
-	// black->Games++;
+	try {
+		return std::make_shared<Nnue::Network>(path);
+	} catch(const std::exception& e) {
+		Send(std::string("info string ") + e.what() + ", using built in network");
+		return std::make_shared<Nnue::Network>();
+	}
+}
 
-	auto chance = 1.0 / (1 + pow(10, (black.Rating - white.Rating) / 400));
-	const int K = 32;
+// "cp <centipawns>" or "mate <moves>", negative when the engine gets mated
+static std::string FormatScore(int score) {
+	if(std::abs(score) < Players::MateBound) {
+		return "cp " + std::to_string(score);
+	}
 
-	white.Games++;
-	black.Games++;
+	const auto plies = Players::MateScore - std::abs(score);
+	return "mate " + std::to_string(score > 0 ? (plies + 1) / 2 : -plies / 2);
+}
 
-	if(game.IsCheck()) {
-		if(game.WhiteMove) {
-			// Black wins
-			white.Rating -= K * chance;
-			black.Rating += K * chance;
-			black.Wins++;
-			return -1;
+// Handles "position [startpos | fen <fen>] [moves <moves>]". When the command only appends moves to the
+// previous one just the new moves are played, which keeps the history and skips parsing the whole game.
+static void SetPosition(const std::string& command, std::string& previous, ChessEngine& game, History& history) {
+	constexpr std::string_view movesToken = " moves ";
+
+	std::string_view moves;
+	if(!previous.empty() && command.starts_with(previous) && command.size() > previous.size()) {
+		moves = std::string_view(command).substr(previous.size());
+
+		// the previous command either ended with a move or had no move list yet
+		const auto hadMoves = previous.find(movesToken) != std::string::npos;
+		if(hadMoves && moves[0] == ' ') {
+			moves.remove_prefix(1);
+		} else if(!hadMoves && moves.starts_with(movesToken)) {
+			moves.remove_prefix(movesToken.size());
 		} else {
-			// White wins
-			white.Rating += K * (1 - chance);
-			black.Rating -= K * (1 - chance);
-			white.Wins++;
-			return 1;
+			moves = {};
 		}
-	} else {
-		// draw
-		white.Rating += 8 * (0.5 - chance);
-		black.Rating += 8 * (chance - 0.5);
-
-		return 0;
 	}
-}
 
-static void RunElo() {
-	EloPlayer players[] = {
-		makeElo<Players::Pacifist>(),
-		makeElo<Players::Generous>(),
-		makeElo<Players::Huddle>(),
-		makeElo<Players::SameColor>(),
-		makeElo<Players::OppositeColor>(),
-		makeElo<Players::Random>(),
-		makeElo<Players::Swarm>(),
-
-		// makeElo<Players::MinOpptMoves>(),
-		// makeElo<Players::Negamax>(3),
-	};
-
-	for(int i = 0; i < 1000; ++i) {
-		for(auto& white : players) {
-			for(auto& black : players) {
-				if(&white == &black) continue;
+	if(moves.empty() && command != previous) {
+		const std::string_view args = std::string_view(command).substr(9);
+		const auto movesPos = args.find(movesToken);
+		const auto position = args.substr(0, movesPos);
 
-				Play(white, black);
-			}
+		if(position.starts_with("fen ")) {
+			game = ChessEngine(std::string(position.substr(4)));
+		} else if(position == "startpos") {
+			game = ChessEngine(); // default constructor uses startpos
+		} else {
+			throw std::logic_error("bad command");
 		}
 
-		for(auto& player : players) {
-			printf("%5.0f %4.1f\n", player.Rating, (player.Wins / (float)player.Games) * 100);
-		}
+		history.Clear();
+		history.Push(game);
 
-		printf("Round: %i\n", i + 1);
+		if(movesPos != std::string_view::npos) {
+			moves = args.substr(movesPos + movesToken.size());
+		}
 	}
 
-	for(auto& player : players) {
-		printf("%f\n", player.Rating);
+	while(!moves.empty()) {
+		const auto length = std::min(moves.find(' '), moves.size());
+		if(length > 0) {
+			game.MakeMove(game.ParseMove(moves.substr(0, length)));
+			history.Push(game);
+		}
+		moves.remove_prefix(std::min(length + 1, moves.size()));
 	}
+
+	previous = command;
 }
 
 void uci() {
@@ -140,66 +135,254 @@ void uci() {
 
 	auto player = Players::Negamax();
 
+	player.OnIteration = [](const Players::SearchInfo& info) {
+		std::stringstream str;
+		str << "info depth " << info.Depth
+			<< " multipv " << info.MultiPv
+			<< " score " << FormatScore(info.Score)
+			<< " nodes " << info.Nodes
+			<< " nps " << info.Nodes * 1000 / std::max<int64_t>(info.Time.count(), 1)
+			<< " time " << info.Time.count()
+			<< " pv";
+		for(const auto move : info.Pv) {
+			str << " " << move;
+		}
+		Send(str.str());
+	};
+
+	Players::MateSolver solver;
+	solver.Stop = &player.Stop;
+	solver.OnProgress = [](int moves, const Players::MateSolver::Result& result) {
+		std::stringstream str;
+		str << "info depth " << moves * 2 - 1
+			<< " nodes " << result.Nodes
+			<< " nps " << result.Nodes * 1000 / std::max<int64_t>(result.Time.count(), 1)
+			<< " time " << result.Time.count();
+		Send(str.str());
+	};
+
+	std::thread searchThread;
+	const auto stopSearch = [&]() {
+		if(searchThread.joinable()) {
+			player.Stop = true;
+			searchThread.join();
+		}
+	};
+
+	bool useNnue = false;
+	std::string evalFile;
+
+	std::unique_ptr<Book> book;
+	int bookDepth = 20;
+	int moveOverhead = 10;
+
+	std::string traceFile;
+	int traceSize = 64;
+
+	History history;
+	player.SetHistory(&history);
+	std::string previousPosition;
+
 	while(true) {
-		getline(std::cin, line);
+		if(!getline(std::cin, line)) {
+			stopSearch();
+			return;
+		}
+
+		if(line.starts_with("position ")) {
+			stopSearch();
+			SetPosition(line, previousPosition, game, history);
+			continue;
+		}
+
 		auto tokens = split(line, " ");
+		if(tokens.empty()) continue;
 
 		if(tokens[0] == "uci") {
-			std::cout
-				<< "id name " << engineName << std::endl
-				<< "id author Redcrafter" << std::endl
-				<< "uciok" << std::endl;
+			Send(
+				std::string("id name ") + engineName + "\n" +
+				"id author Redcrafter\n" +
+				"option name UseNNUE type check default false\n" +
+				"option name EvalFile type string default <empty>\n" +
+				"option name BitbasePath type string default <empty>\n" +
+				"option name BookFile type string default <empty>\n" +
+				"option name BookDepth type spin default 20 min 0 max 200\n" +
+				"option name MoveOverhead type spin default 10 min 0 max 5000\n" +
+				"option name Hash type spin default 16 min 1 max 4096\n" +
+				"option name Threads type spin default 1 min 1 max 256\n" +
+				"option name Ponder type check default false\n" +
+				"option name MultiPV type spin default 1 min 1 max 256\n" +
+				"option name TraceFile type string default <empty>\n" +
+				"option name TraceSize type spin default 64 min 1 max 65536\n" +
+				"uciok"
+			);
 		} else if(tokens[0] == "isready") {
-			std::cout << "readyok" << std::endl;
+			Send("readyok");
+		} else if(tokens[0] == "stop") {
+			stopSearch();
+		} else if(tokens[0] == "ponderhit") {
+			// the search keeps going and now uses the time limits of its go command
+			player.Ponder = false;
 		} else if(tokens[0] == "setoption") {
-			// no options supported yet
-		} else if(tokens[0] == "ucinewgame") {
-			// nothing to do
-		} else if(tokens[0] == "position") {
-			if(tokens[1] == "fen") {
-				game = ChessEngine(line.substr(13));
+			// setoption name <id> [value <x>]
+			if(tokens.size() < 3) continue;
+			stopSearch();
+
+			const auto valuePos = line.find(" value ");
+			const auto value = valuePos == std::string::npos ? "" : line.substr(valuePos + 7);
+			const auto& name = tokens[2];
+
+			if(name == "UseNNUE") {
+				useNnue = value == "true";
+			} else if(name == "EvalFile") {
+				evalFile = value;
+			} else if(name == "BitbasePath") {
+				std::shared_ptr<Bitbases> bitbases;
+
+				if(!value.empty() && value != "<empty>") {
+					bitbases = std::make_shared<Bitbases>();
+					try {
+						bitbases->Load(value);
+						Send("info string loaded " + std::to_string(bitbases->Count()) + " bitbases");
+					} catch(const std::exception& e) {
+						Send(std::string("info string ") + e.what());
+					}
+				}
+
+				player.UseBitbases(bitbases);
+				continue;
+			} else if(name == "BookFile") {
+				book = nullptr;
+
+				if(!value.empty() && value != "<empty>") {
+					try {
+						book = std::make_unique<Book>(value);
+						Send("info string loaded " + std::to_string(book->Size()) + " book entries");
+					} catch(const std::exception& e) {
+						Send(std::string("info string ") + e.what());
+					}
+				}
+				continue;
+			} else if(name == "BookDepth") {
+				bookDepth = std::atoi(value.c_str());
+				continue;
+			} else if(name == "MoveOverhead") {
+				moveOverhead = std::atoi(value.c_str());
+				continue;
+			} else if(name == "MultiPV") {
+				player.MultiPv = std::max(std::atoi(value.c_str()), 1);
+				continue;
+			} else if(name == "Hash") {
+				player.SetHashSize(std::max(std::atoi(value.c_str()), 1));
+				continue;
+			} else if(name == "Threads") {
+				player.Threads = std::clamp(std::atoi(value.c_str()), 1, 256);
+				continue;
+			} else if(name == "TraceFile" || name == "TraceSize") {
+				if(name == "TraceFile") {
+					traceFile = value == "<empty>" ? "" : value;
+				} else {
+					traceSize = std::max(std::atoi(value.c_str()), 1);
+				}
 
-			} else if(tokens[1] == "startpos") {
-				game = ChessEngine(); // default constructor uses startpos
+				try {
+					player.SetTrace(traceFile, traceSize);
+				} catch(const std::exception& e) {
+					player.SetTrace("", 0);
+					Send(std::string("info string ") + e.what());
+				}
+				continue;
 			} else {
-				throw std::logic_error("bad command");
+				continue;
 			}
 
-			if(line.find("moves") != std::string::npos) {
-				line = line.substr(line.find("moves") + 6);
-				auto gameMoves = split(line, " ");
-
-				for(int i = 0; i < gameMoves.size(); ++i) {
-					auto moveString = gameMoves[i];
-
-					Move m(moveString, MoveType::Error);
+			player.UseNetwork(useNnue ? LoadNetwork(evalFile) : nullptr);
+		} else if(tokens[0] == "ucinewgame") {
+			stopSearch();
+			player.NewGame();
+		} else if(tokens[0] == "go") {
+			stopSearch();
+
+			const auto limits = Players::SearchLimits::Parse(tokens, game.WhiteMove, std::chrono::milliseconds(moveOverhead));
+			const auto ponder = std::find(tokens.begin(), tokens.end(), "ponder") != tokens.end();
+
+			const auto ply = (game.FullMoves - 1) * 2 + !game.WhiteMove;
+			if(book && !limits.Infinite && !ponder && ply < bookDepth) {
+				const auto move = book->Probe(game);
+				if(move.Type != MoveType::Error) {
+					std::stringstream str;
+					str << "bestmove " << move;
+					Send("info string book move");
+					Send(str.str());
+					continue;
+				}
+			}
 
-					// find right move type
-					for(Move move : game.GetMoves()) {
-						if(move.X0 == m.X0 && move.Y0 == m.Y0 && move.X1 == m.X1 && move.Y1 == m.Y1) {
-							m = move;
-							break;
+			player.Stop = false;
+			player.Ponder = ponder;
+			searchThread = std::thread([&player, &solver, game, limits]() mutable {
+				if(limits.Mate > 0) {
+					solver.MaxNodes = limits.Nodes;
+					const auto result = solver.Solve(game, limits.Mate);
+
+					if(result.Moves) {
+						std::stringstream str;
+						str << "info depth " << result.Moves * 2 - 1
+							<< " score mate " << result.Moves
+							<< " nodes " << result.Nodes
+							<< " nps " << result.Nodes * 1000 / std::max<int64_t>(result.Time.count(), 1)
+							<< " time " << result.Time.count()
+							<< " pv";
+						for(const auto move : result.Pv) {
+							str << " " << move;
 						}
-					}
+						Send(str.str());
 
-					if(moveString.length() == 5) {
-						switch(moveString[4]) {
-							case 'n': m.Type = MoveType::PromotionN; break;
-							case 'r': m.Type = MoveType::PromotionR; break;
-							case 'b': m.Type = MoveType::PromotionB; break;
-							case 'q': m.Type = MoveType::PromotionQ; break;
-							default: throw std::logic_error("bad move format");
+						str.str("");
+						str << "bestmove " << result.Pv[0];
+						if(result.Pv.size() > 1) {
+							str << " ponder " << result.Pv[1];
 						}
+						Send(str.str());
+						return;
 					}
 
-					game.MakeMove(m);
+					// no mate within the limit, answer with a normal search
+					Send("info string no mate in " + std::to_string(limits.Mate) + " found");
+				}
+
+				Counters::Reset();
+				auto move = player.Search(game, limits);
+
+				// go infinite and ponder only answer after stop or ponderhit
+				while((limits.Infinite || player.Ponder) && !player.Stop) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+
+				const auto& stats = player.Stats();
+				std::stringstream str;
+				str << "info nodes " << stats.Nodes
+					<< " tbhits " << stats.BitbaseHits
+					<< " string pawnhash " << (stats.PawnProbes ? stats.PawnHits * 100.0 / stats.PawnProbes : 0.0) << "%";
+				Send(str.str());
+
+				if(Counters::Enabled) {
+					std::istringstream report(Counters::Report());
+					std::string line;
+					while(std::getline(report, line)) {
+						Send("info string " + line);
+					}
 				}
-			}
-		} else if(tokens[0] == "go") {
-			auto move = player.MakeMove(game);
 
-			std::cout << "bestmove " << move << std::endl;
+				str.str("");
+				str << "bestmove " << move;
+				if(player.Pv().size() > 1) {
+					str << " ponder " << player.Pv()[1];
+				}
+				Send(str.str());
+			});
 		} else if(tokens[0] == "quit") {
+			stopSearch();
 			return;
 		}
 	}
@@ -266,6 +449,17 @@ int main(int argc, char* argv[]) {
 
 	CalcMagic();
 
+	// --counters anywhere on the command line adds hardware counters to perf and bench
+	bool counters = false;
+	for(int i = 1; i < argc; i++) {
+		if(std::string(argv[i]) == "--counters") {
+			counters = true;
+			std::copy(argv + i + 1, argv + argc, argv + i);
+			argc--;
+			break;
+		}
+	}
+
 	if(argc > 1) {
 		std::string val = argv[1];
 
@@ -273,12 +467,115 @@ int main(int argc, char* argv[]) {
 			uci();
 		} else if(val == "test") {
 			MoveTest();
+			BookTest();
+			GameEndTest();
 		} else if(val == "perf") {
 			int count = 6;
 			if(argc > 2) {
 				count = std::atoi(argv[2]);
 			}
-			PerformanceTest(count);
+			PerformanceTest(count, counters);
+		} else if(val == "perftsuite") {
+			if(argc < 3) {
+				std::cout << "Usage: perftsuite <file.epd> [max depth] [json]" << std::endl;
+				return 1;
+			}
+			PerftSuite(argv[2], argc > 3 ? std::atoi(argv[3]) : 7, argc > 4 ? argv[4] : "");
+		} else if(val == "trace") {
+			if(argc < 3) {
+				std::cout << "Usage: trace <file> [key] [levels]" << std::endl;
+				return 1;
+			}
+			const auto key = argc > 3 ? std::stoull(argv[3], nullptr, 16) : 0;
+			Players::AnalyzeTrace(argv[2], key, argc > 4 ? std::atoi(argv[4]) : 1);
+		} else if(val == "bench") {
+			const auto depth = argc > 2 ? std::atoi(argv[2]) : 5;
+			Bench(depth, argc > 3 ? argv[3] : "", counters);
+		} else if(val == "scaling") {
+			Scaling(argc > 2 ? std::atoi(argv[2]) : 0, argc > 3 ? std::atoi(argv[3]) : 3, argc > 4 ? argv[4] : "");
+		} else if(val == "microbench") {
+			const bool save = argc > 3 && std::string(argv[3]) == "save";
+			MicroBench(argc > 2 ? argv[2] : "", save);
+		} else if(val == "nnuebench") {
+			auto network = LoadNetwork(argc > 2 ? argv[2] : "");
+			Nnue::Benchmark(*network, 2);
+		} else if(val == "bitbase") {
+			if(argc < 3) {
+				std::cout << "Missing bitbase directory" << std::endl;
+				return 1;
+			}
+
+			std::vector<std::string> sets = { "KPK", "KNK", "KBK", "KRK", "KQK" };
+			if(argc > 3) {
+				sets.assign(argv + 3, argv + argc);
+			}
+
+			Bitbases bitbases;
+			if(std::filesystem::exists(argv[2])) {
+				bitbases.Load(argv[2]);
+			}
+			for(const auto& set : sets) {
+				bitbases.Generate(argv[2], set);
+			}
+		} else if(val == "makebook") {
+			if(argc < 4) {
+				std::cout << "Usage: makebook <games.txt> <book.bin> [plies]" << std::endl;
+				return 1;
+			}
+
+			Book::Create(argv[2], argv[3], argc > 4 ? std::atoi(argv[4]) : 20);
+		} else if(val == "elo") {
+			Adjudication rules;
+			if(argc > 4) rules.ResignScore = std::atoi(argv[4]);
+			if(argc > 5) rules.DrawScore = std::atoi(argv[5]);
+
+			RunElo(argc > 2 ? std::atoi(argv[2]) : 1000, argc > 3 ? std::stoull(argv[3]) : 1, rules);
+		} else if(val == "sprt") {
+			if(argc < 4) {
+				std::cout << "Missing engine configurations" << std::endl;
+				return 1;
+			}
+
+			SprtBounds bounds;
+			if(argc > 4) bounds.Elo0 = std::atof(argv[4]);
+			if(argc > 5) bounds.Elo1 = std::atof(argv[5]);
+			if(argc > 6) bounds.Alpha = std::atof(argv[6]);
+			if(argc > 7) bounds.Beta = std::atof(argv[7]);
+
+			try {
+				RunSprt(EngineConfig::Parse(argv[2]), EngineConfig::Parse(argv[3]), bounds, argc > 8 ? std::atoi(argv[8]) : 20000, argc > 9 ? argv[9] : "");
+			} catch(const std::exception& e) {
+				std::cout << e.what() << std::endl;
+				return 1;
+			}
+		} else if(val == "gauntlet") {
+			if(argc < 7) {
+				std::cout << "Missing gauntlet parameters" << std::endl;
+				return 1;
+			}
+
+			const TimeControl time{ std::chrono::milliseconds(std::atoi(argv[4])), std::chrono::milliseconds(std::atoi(argv[5])) };
+			// a mistyped option or an engine that doesn't start ends the run before any game
+			try {
+				RunGauntlet(EngineConfig::Parse(argv[2]), std::vector<std::string>(argv + 6, argv + argc), std::atoi(argv[3]), time);
+			} catch(const std::exception& e) {
+				std::cout << e.what() << std::endl;
+				return 1;
+			}
+		} else if(val == "datagen") {
+			if(argc < 4) {
+				std::cout << "Missing output prefix or position count" << std::endl;
+				return 1;
+			}
+
+			DataGen(argv[2], std::stoull(argv[3]), argc > 4 ? std::stoull(argv[4]) : 5000, argc > 5 ? std::stoull(argv[5]) : 1);
+		} else if(val == "tune") {
+			if(argc < 6) {
+				std::cout << "Missing tune parameters" << std::endl;
+				return 1;
+			}
+
+			Tune(std::vector<std::string>(argv + 5, argv + argc), argv[2], std::atoi(argv[3]), std::atof(argv[4]));
 		} else if(val == "play") {
 			PlayConsole();
 		} else {
@@ -289,9 +586,23 @@ int main(int argc, char* argv[]) {
 			<< "Missing command parameter" << std::endl
 			<< "Possible options are" << std::endl
 			<< "play:	play normally against the engine" << std::endl
+			<< "elo [rounds] [seed] [resign cp] [draw cp]:	round robin of the simple players, 0 turns an adjudication off" << std::endl
+			<< "sprt <config> <config> [elo0] [elo1] [alpha] [beta] [max pairs] [openings]:	match two Negamax configurations like depth=4,nodes=20000,hash=16,nnue=net.bin until the SPRT decides" << std::endl
+			<< "gauntlet <config> <rounds> <time ms> <increment ms> <engine>...:	play Negamax against local uci engines" << std::endl
+			<< "datagen <prefix> <positions> [nodes] [seed]:	write scored self-play positions to <prefix>.<thread>.bin" << std::endl
+			<< "tune <output> <epochs> <lambda> <file>...:	fit the piece square tables to datagen files and write them as c++, lambda 1 uses only game results" << std::endl
 			<< "test:	run engine tests" << std::endl
 			<< "perf:	run performance test" << std::endl
-			<< "uci:	enter uci mode" << std::endl;
+			<< "perftsuite <file.epd> [max depth] [json]:	check perft counts of an epd file" << std::endl
+			<< "bench [depth] [json]:	search benchmark, prints the node count signature" << std::endl
+			<< "trace <file> [key] [levels]:	analyze a search trace written with the uci option TraceFile" << std::endl
+			<< "scaling [max threads] [repetitions] [json]:	perft and search speedup by thread count" << std::endl
+			<< "microbench [baseline] [save]:	time single engine functions, compared against or saved to the baseline" << std::endl
+			<< "nnuebench [file]:	measure evaluation speed" << std::endl
+			<< "bitbase <dir> [sets]:	generate endgame bitbases like KRK or KQKR" << std::endl
+			<< "makebook <games> <book> [plies]:	build a polyglot book from games in uci notation" << std::endl
+			<< "uci:	enter uci mode" << std::endl
+			<< "--counters:	add hardware performance counters to perf and bench (Linux)" << std::endl;
 	}
 
 	return 0;
@@ -8,3 +8,14 @@
 
 #define popcnt64 _mm_popcnt_u64
 #define NumberOfTrailingZeros _tzcnt_u64
+
+// Makes the compiler treat value as used so benchmarks keep the work that produced it
+template<class T>
+inline void DoNotOptimize(const T& value) {
+#if _MSC_VER
+	static volatile T sink;
+	sink = value;
+#else
+	asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
@@ -0,0 +1,249 @@
+#include "External.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#if _WIN32 || _WIN64
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std::chrono;
+
+// time an engine gets to start up and to answer beyond its clock
+constexpr milliseconds StartupTime{ 5000 };
+constexpr milliseconds Grace{ 1000 };
+constexpr milliseconds Untimed{ 60000 };
+
+#if _WIN32 || _WIN64
+
+Players::External::External(const std::string& command, const std::string& go) {
+	throw std::runtime_error("External engines are only supported on posix systems");
+}
+
+Players::External::~External() {}
+
+void Players::External::Stop(milliseconds grace) {}
+
+void Players::External::Send(const std::string& line) {}
+
+bool Players::External::ReadLine(std::string& line, steady_clock::time_point deadline) {
+	return false;
+}
+
+#else
+
+Players::External::External(const std::string& command, const std::string& go) : name(command), go(go) {
+	// a crashed engine would otherwise kill us on the next write
+	signal(SIGPIPE, SIG_IGN);
+
+	// close on exec keeps the pipes of games running in parallel out of this child
+	int toChild[2], fromChild[2];
+	if(pipe2(toChild, O_CLOEXEC) != 0) {
+		throw std::runtime_error("Can't create pipe for " + command);
+	}
+	if(pipe2(fromChild, O_CLOEXEC) != 0) {
+		close(toChild[0]);
+		close(toChild[1]);
+		throw std::runtime_error("Can't create pipe for " + command);
+	}
+
+	pid = fork();
+	if(pid == 0) {
+		// only async signal safe calls until exec, the own process group lets Stop kill whatever the shell starts
+		setpgid(0, 0);
+		dup2(toChild[0], STDIN_FILENO);
+		dup2(fromChild[1], STDOUT_FILENO);
+		execl("/bin/sh", "sh", "-c", command.c_str(), (char*)nullptr);
+		_exit(127);
+	}
+
+	if(pid > 0) setpgid(pid, pid);
+	close(toChild[0]);
+	close(fromChild[1]);
+	if(pid < 0) {
+		close(toChild[1]);
+		close(fromChild[0]);
+		throw std::runtime_error("Can't start " + command);
+	}
+
+	input = toChild[1];
+	output = fromChild[0];
+	fcntl(output, F_SETFL, fcntl(output, F_GETFL) | O_NONBLOCK);
+
+	std::string line;
+	Send("uci");
+	const auto deadline = steady_clock::now() + StartupTime;
+	while(true) {
+		if(!ReadLine(line, deadline)) {
+			Stop(milliseconds(0));
+			throw std::runtime_error(command + " didn't answer uci");
+		}
+		if(line.starts_with("id name ")) {
+			name = line.substr(8);
+		} else if(line == "uciok") {
+			break;
+		}
+	}
+
+	Send("ucinewgame");
+	Send("isready");
+	if(!WaitFor("readyok", line, deadline)) {
+		Stop(milliseconds(0));
+		throw std::runtime_error(command + " didn't answer isready");
+	}
+}
+
+Players::External::~External() {
+	Stop(milliseconds(500));
+}
+
+void Players::External::Stop(milliseconds grace) {
+	if(pid <= 0) return;
+
+	Send("quit");
+	close(input);
+	close(output);
+
+	// engines get a moment to exit by themselves
+	const auto deadline = steady_clock::now() + grace;
+	while(waitpid(pid, nullptr, WNOHANG) == 0) {
+		if(steady_clock::now() >= deadline) {
+			kill(-pid, SIGKILL);
+			waitpid(pid, nullptr, 0);
+			break;
+		}
+		usleep(1000);
+	}
+	pid = -1;
+}
+
+void Players::External::Send(const std::string& line) {
+	const auto text = line + "\n";
+	size_t written = 0;
+	while(written < text.size()) {
+		const auto count = write(input, text.data() + written, text.size() - written);
+		if(count <= 0) return;
+		written += count;
+	}
+}
+
+bool Players::External::ReadLine(std::string& line, steady_clock::time_point deadline) {
+	while(true) {
+		const auto end = buffer.find('\n');
+		if(end != std::string::npos) {
+			line = buffer.substr(0, end);
+			if(!line.empty() && line.back() == '\r') line.pop_back();
+			buffer.erase(0, end + 1);
+			return true;
+		}
+
+		const auto left = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+		if(left <= 0) {
+			return false;
+		}
+
+		pollfd fd{ output, POLLIN, 0 };
+		if(poll(&fd, 1, (int)std::min<int64_t>(left, 100)) <= 0) {
+			continue;
+		}
+
+		char data[4096];
+		const auto count = read(output, data, sizeof(data));
+		if(count > 0) {
+			buffer.append(data, count);
+		} else if(count == 0) {
+			return false; // engine closed its output
+		}
+	}
+}
+
+#endif
+
+bool Players::External::WaitFor(const std::string& prefix, std::string& line, steady_clock::time_point deadline) {
+	while(ReadLine(line, deadline)) {
+		if(line.starts_with(prefix)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+Move Players::External::MakeMove(ChessEngine& game) {
+	// the opponent's move is found by its key, anything else starts over from this position
+	bool found = false;
+	if(started) {
+		for(const auto move : last.GetMoves()) {
+			auto cp = last;
+			cp.MakeMove(move);
+			if(cp.IsValid() && cp.Hash == game.Hash) {
+				moves.push_back(move);
+				found = true;
+				break;
+			}
+		}
+	}
+	if(!found) {
+		start = game;
+		moves.clear();
+		started = true;
+	}
+
+	std::ostringstream position;
+	position << "position fen " << start.Fen();
+	if(!moves.empty()) {
+		position << " moves";
+		for(const auto move : moves) {
+			position << " " << move;
+		}
+	}
+	Send(position.str());
+
+	auto deadline = steady_clock::now();
+	if(clock) {
+		Send("go wtime " + std::to_string(clock->White.count()) + " btime " + std::to_string(clock->Black.count()) +
+			" winc " + std::to_string(clock->Increment.count()) + " binc " + std::to_string(clock->Increment.count()));
+		deadline += (game.WhiteMove ? clock->White : clock->Black) + Grace;
+	} else {
+		Send("go " + go);
+		deadline += Untimed;
+	}
+
+	std::string line;
+	if(!WaitFor("bestmove ", line, deadline)) {
+		return {};
+	}
+
+	std::istringstream tokens(line.substr(9));
+	std::string text;
+	tokens >> text;
+
+	Move move;
+	try {
+		move = game.ParseMove(text);
+	} catch(const std::logic_error&) {
+		return {};
+	}
+
+	bool legal = false;
+	for(const auto candidate : game.GetMoves()) {
+		legal |= candidate == move && candidate.Type == move.Type;
+	}
+	if(!legal) {
+		return {};
+	}
+
+	auto cp = game;
+	cp.MakeMove(move);
+	if(!cp.IsValid()) {
+		return {};
+	}
+
+	last = cp;
+	moves.push_back(move);
+	return move;
+}
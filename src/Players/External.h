@@ -0,0 +1,47 @@
+#pragma once
+#include "Player.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace Players {
+	// UCI engine running as a child process, every move waits with a deadline instead of blocking on the pipe
+	class External : public Player {
+	public:
+		// The command is run by /bin/sh, go is the search command used when no clock is set
+		External(const std::string& command, const std::string& go = "movetime 100");
+		~External();
+
+		External(const External&) = delete;
+		External& operator=(const External&) = delete;
+
+		// Returns a move with MoveType::Error when the engine doesn't answer in time or plays an illegal move
+		Move MakeMove(ChessEngine& game) override;
+
+		// "id name" of the engine or the command if it didn't send one
+		const std::string& Name() const { return name; }
+	private:
+		std::string name;
+		std::string go;
+
+		int pid = -1;
+		int input = -1;
+		int output = -1;
+		std::string buffer;
+
+		// the game is sent as the first position and the moves since, so the engine can see repetitions
+		ChessEngine start;
+		ChessEngine last;
+		std::vector<Move> moves;
+		bool started = false;
+
+		// Asks the engine to quit and kills it once grace has passed, also cleans up after a failed start
+		void Stop(std::chrono::milliseconds grace);
+		void Send(const std::string& line);
+		// Next line of output, false when none arrived before the deadline or the engine exited
+		bool ReadLine(std::string& line, std::chrono::steady_clock::time_point deadline);
+		// Skips output until a line starts with prefix
+		bool WaitFor(const std::string& prefix, std::string& line, std::chrono::steady_clock::time_point deadline);
+	};
+}
@@ -0,0 +1,197 @@
+#include "MateSolver.h"
+
+#include <algorithm>
+#include <bit>
+
+Players::MateSolver::MateSolver(size_t megabytes) {
+	const auto count = std::bit_floor(std::max<size_t>(megabytes * 1024 * 1024 / sizeof(Entry), 1));
+	entries.resize(count);
+	mask = count - 1;
+}
+
+// the same position is a different problem with a different number of plies left
+uint64_t Players::MateSolver::Key(const ChessEngine& game, int plies) {
+	return game.Hash ^ (plies * 0x9E3779B97F4A7C15ULL);
+}
+
+Players::MateSolver::Entry Players::MateSolver::Lookup(const ChessEngine& game, int plies) const {
+	const auto key = Key(game, plies);
+	const auto& entry = entries[key & mask];
+	return entry.Key == key ? entry : Entry{ key };
+}
+
+void Players::MateSolver::Store(const ChessEngine& game, int plies, uint32_t proof, uint32_t disproof) {
+	const auto key = Key(game, plies);
+	entries[key & mask] = { key, proof, disproof };
+}
+
+// GetMoves also brings the check state of the side to move up to date
+static std::vector<ChessEngine> Children(ChessEngine& game) {
+	std::vector<ChessEngine> children;
+
+	for(const auto move : game.GetMoves()) {
+		auto child = game;
+		child.MakeMove(move);
+		if(child.IsValid()) {
+			children.push_back(child);
+		}
+	}
+	return children;
+}
+
+void Players::MateSolver::Search(const ChessEngine& game, int plies, uint32_t proofLimit, uint32_t disproofLimit) {
+	nodes++;
+	if((Stop && Stop->load(std::memory_order_relaxed)) || (MaxNodes && nodes >= MaxNodes)) {
+		aborted = true;
+		return;
+	}
+
+	const bool attacker = plies & 1;
+
+	auto position = game;
+	const auto children = Children(position);
+
+	if(children.empty()) {
+		if(!attacker && position.IsCheck()) {
+			Store(game, plies, 0, Infinity);
+		} else {
+			Store(game, plies, Infinity, 0);
+		}
+		return;
+	}
+	if(plies == 0) {
+		Store(game, plies, Infinity, 0);
+		return;
+	}
+
+	while(true) {
+		// the attacker needs one proven move, the defender all moves proven
+		uint64_t proof = attacker ? Infinity : 0;
+		uint64_t disproof = attacker ? 0 : Infinity;
+		int best = 0;
+		uint64_t second = Infinity;
+		uint64_t bestValue = Infinity;
+
+		for(int i = 0; i < (int)children.size(); i++) {
+			const auto entry = Lookup(children[i], plies - 1);
+
+			// the attacker follows the easiest proof, the defender the easiest disproof
+			const uint64_t value = attacker ? entry.Proof : entry.Disproof;
+			if(value < bestValue) {
+				second = bestValue;
+				bestValue = value;
+				best = i;
+			} else if(value < second) {
+				second = value;
+			}
+
+			if(attacker) {
+				proof = std::min<uint64_t>(proof, entry.Proof);
+				disproof = std::min<uint64_t>(disproof + entry.Disproof, Infinity);
+			} else {
+				proof = std::min<uint64_t>(proof + entry.Proof, Infinity);
+				disproof = std::min<uint64_t>(disproof, entry.Disproof);
+			}
+		}
+
+		if(proof >= proofLimit || disproof >= disproofLimit) {
+			Store(game, plies, proof, disproof);
+			return;
+		}
+
+		const auto entry = Lookup(children[best], plies - 1);
+		if(attacker) {
+			const auto childProof = std::min<uint64_t>(proofLimit, second + 1);
+			const auto childDisproof = std::min<uint64_t>(disproofLimit - disproof + entry.Disproof, Infinity);
+			Search(children[best], plies - 1, childProof, childDisproof);
+		} else {
+			const auto childProof = std::min<uint64_t>(proofLimit - proof + entry.Proof, Infinity);
+			const auto childDisproof = std::min<uint64_t>(disproofLimit, second + 1);
+			Search(children[best], plies - 1, childProof, childDisproof);
+		}
+
+		if(aborted) {
+			return;
+		}
+	}
+}
+
+void Players::MateSolver::Pv(const ChessEngine& game, int plies, std::vector<Move>& pv) {
+	if(plies == 0) {
+		return;
+	}
+
+	const auto proven = [&](const ChessEngine& child, int left) {
+		auto entry = Lookup(child, left);
+		if(entry.Proof != 0 && entry.Disproof != 0) {
+			Search(child, left, Infinity, Infinity);
+			entry = Lookup(child, left);
+		}
+		return entry.Proof == 0;
+	};
+
+	Move choice{};
+	int choicePlies = -1;
+
+	auto cp = game;
+	for(const auto move : cp.GetMoves()) {
+		auto child = game;
+		child.MakeMove(move);
+		if(!child.IsValid()) continue;
+
+		// the attacker takes the quickest mate, the defender the slowest
+		for(int left = (plies - 1) & 1; left < plies; left += 2) {
+			if(aborted) return;
+			if(!proven(child, left)) continue;
+
+			if((plies & 1) ? (choicePlies < 0 || left < choicePlies) : left > choicePlies) {
+				choice = move;
+				choicePlies = left;
+			}
+			break;
+		}
+	}
+
+	if(choicePlies < 0) {
+		return;
+	}
+
+	pv.push_back(choice);
+	auto next = game;
+	next.MakeMove(choice);
+	Pv(next, choicePlies, pv);
+}
+
+Players::MateSolver::Result Players::MateSolver::Solve(const ChessEngine& game, int maxMoves) {
+	const auto start = std::chrono::steady_clock::now();
+	const auto elapsed = [&]() {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	};
+
+	std::fill(entries.begin(), entries.end(), Entry{});
+	nodes = 0;
+	aborted = false;
+
+	Result result;
+
+	// longer mates are only tried once the shorter ones are disproven, so the first proof is the shortest
+	for(int moves = 1; moves <= maxMoves; moves++) {
+		const auto plies = moves * 2 - 1;
+		Search(game, plies, Infinity, Infinity);
+		if(aborted) break;
+
+		if(Lookup(game, plies).Proof == 0) {
+			result.Moves = moves;
+			Pv(game, plies, result.Pv);
+			break;
+		}
+
+		if(OnProgress) {
+			OnProgress(moves, { 0, {}, nodes, elapsed() });
+		}
+	}
+
+	result.Nodes = nodes;
+	result.Time = elapsed();
+	return result;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "../Engine/ChessEngine.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Players {
+	// Finds forced mates for the side to move with depth first proof number search (df-pn)
+	class MateSolver {
+	public:
+		struct Result {
+			int Moves = 0; // 0 when no mate was found
+			std::vector<Move> Pv;
+			uint64_t Nodes = 0;
+			std::chrono::milliseconds Time{ 0 };
+		};
+
+		const std::atomic<bool>* Stop = nullptr;
+		// 0 means unlimited
+		uint64_t MaxNodes = 0;
+		// Reported for every mate length that was disproven on the way
+		std::function<void(int moves, const Result&)> OnProgress;
+
+		MateSolver(size_t megabytes = 16);
+
+		// Shortest mate in at most maxMoves moves
+		Result Solve(const ChessEngine& game, int maxMoves);
+	private:
+		static constexpr uint32_t Infinity = 1u << 30;
+
+		struct Entry {
+			uint64_t Key = 0;
+			uint32_t Proof = 1;
+			uint32_t Disproof = 1;
+		};
+
+		std::vector<Entry> entries;
+		uint64_t mask;
+		uint64_t nodes = 0;
+		bool aborted = false;
+
+		static uint64_t Key(const ChessEngine& game, int plies);
+		Entry Lookup(const ChessEngine& game, int plies) const;
+		void Store(const ChessEngine& game, int plies, uint32_t proof, uint32_t disproof);
+
+		// attacker to move at odd plies, the defender at even plies
+		void Search(const ChessEngine& game, int plies, uint32_t proofLimit, uint32_t disproofLimit);
+		void Pv(const ChessEngine& game, int plies, std::vector<Move>& pv);
+	};
+}
@@ -1,5 +1,9 @@
 #include "Negamax.h"
 #include "Platform.h"
+#include "../Engine/Counters.h"
+
+#include <algorithm>
+#include <omp.h>
 
 #if true
 
@@ -202,7 +206,19 @@ struct Tables {
 
 Tables tables{};
 
-static int eval(const ChessEngine& g) {
+int PestoMaterial(bool endgame, int piece) {
+	return (endgame ? eg_value : mg_value)[piece];
+}
+
+int PestoSquare(bool endgame, int piece, int square) {
+	return (endgame ? eg_pesto_table : mg_pesto_table)[piece][square];
+}
+
+int PestoPhase(int piece) {
+	return gamephaseInc[piece * 2];
+}
+
+int eval(const ChessEngine& g, PawnTable& pawns) {
 	int mg[2]{ 0,0 };
 	int eg[2]{ 0,0 };
 	int gamePhase = 0;
@@ -233,6 +249,10 @@ static int eval(const ChessEngine& g) {
 	handle(g.Q & g.Black, BLACK_QUEEN, BLACK);
 	handle(g.K & g.Black, BLACK_KING, BLACK);
 
+	const auto& pawnEntry = pawns.Probe(g);
+	mg[WHITE] += pawnEntry.Mg;
+	eg[WHITE] += pawnEntry.Eg;
+
 	int side2move = g.WhiteMove ? WHITE : BLACK;
 	
 	// tapered eval
@@ -248,7 +268,7 @@ static int eval(const ChessEngine& g) {
 }
 #else
 
-static int eval(ChessEngine& g) {
+int eval(const ChessEngine& g, PawnTable& pawns) {
     int score =
         9 * (popcnt64(g.White & g.Q) - popcnt64(g.Black & g.Q)) +
         5 * (popcnt64(g.White & g.R) - popcnt64(g.Black & g.R)) +
@@ -263,13 +283,154 @@ static int eval(ChessEngine& g) {
 }
 #endif
 
-static int alphaBeta(ChessEngine& game, int alpha, int beta, int depth) {
-	if(depth == 0) {
-		return eval(game); // quiesce(alpha, beta);
+constexpr int BitbaseWin = 5000;
+
+// mate scores are stored relative to the node instead of the root
+static int ScoreToTable(int score, int ply) {
+	if(score >= Players::MateBound) return score + ply;
+	if(score <= -Players::MateBound) return score - ply;
+	return score;
+}
+
+static int ScoreFromTable(int score, int ply) {
+	if(score >= Players::MateBound) return score - ply;
+	if(score <= -Players::MateBound) return score + ply;
+	return score;
+}
+
+struct ScoredMove {
+	Move move;
+	int score;
+};
+
+static bool IsPromotion(const Move m) {
+	return m.Type >= MoveType::PromotionN && m.Type <= MoveType::PromotionQ;
+}
+
+// The hash move, winning and equal captures first, then quiet moves, then losing captures.
+// Quiescence only keeps the captures and promotions that don't lose material.
+static Test OrderMoves(const ChessEngine& game, const Test& moves, bool quiescence, Move hashMove = {}) {
+	std::array<ScoredMove, 128> scored;
+	int count = 0;
+
+	for(const auto move : moves) {
+		int score = 0;
+
+		if(move == hashMove && move.Type == hashMove.Type) {
+			score = 1000000;
+		} else if(game.IsCapture(move) || IsPromotion(move)) {
+			const auto see = game.SEE(move);
+			if(quiescence && see < 0) continue;
+
+			score = see >= 0 ? 100000 + see : -100000 + see;
+		} else if(quiescence) {
+			continue;
+		}
+
+		scored[count++] = { move, score };
+	}
+
+	std::stable_sort(scored.begin(), scored.begin() + count, [](const ScoredMove& a, const ScoredMove& b) {
+		return a.score > b.score;
+	});
+
+	Test ordered;
+	for(int i = 0; i < count; i++) {
+		ordered.push(scored[i].move);
+	}
+	return ordered;
+}
+
+void Players::Negamax::UseNetwork(std::shared_ptr<const Nnue::Network> network) {
+	this->network = std::move(network);
+	if(this->network) {
+		accumulators.resize(MaxPly + 1);
 	}
+}
+
+void Players::Negamax::UseBitbases(std::shared_ptr<const Bitbases> bitbases) {
+	this->bitbases = std::move(bitbases);
+}
 
-	auto moves = game.GetMoves();
-	auto valid = false;
+void Players::Negamax::NewGame() {
+	table->Clear();
+	pawnTable.Clear();
+	for(auto& helper : helpers) {
+		helper->pawnTable.Clear();
+	}
+}
+
+void Players::Negamax::SetTrace(const std::string& path, size_t megabytes) {
+	trace = path.empty() ? nullptr : std::make_unique<SearchTrace>(path, megabytes);
+}
+
+bool Players::Negamax::Aborted() {
+	if(aborted) {
+		return true;
+	}
+	if(Stop.load(std::memory_order_relaxed)) {
+		aborted = true;
+		return true;
+	}
+
+	if(pondering) {
+		if(Ponder.load(std::memory_order_relaxed)) {
+			return false;
+		}
+
+		// ponderhit, the time for this move starts now
+		pondering = false;
+		timer = TimeManager(limits);
+	}
+
+	// the clock is only read every 1024 nodes
+	if((limits.Nodes && stats.Nodes >= limits.Nodes) || ((stats.Nodes & 1023) == 0 && timer.OutOfTime())) {
+		aborted = true;
+	}
+	return aborted;
+}
+
+int Players::Negamax::Evaluate(const ChessEngine& game, int ply) {
+	Counters::Eval();
+	if(network) {
+		return network->Evaluate(accumulators[ply], game.WhiteMove);
+	}
+	return eval(game, pawnTable);
+}
+
+void Players::Negamax::Update(const ChessEngine& parent, const ChessEngine& child, int ply) {
+	if(network) {
+		network->Update(parent, child, accumulators[ply], accumulators[ply + 1]);
+	}
+}
+
+int Players::Negamax::Quiesce(ChessEngine& game, int alpha, int beta, int ply) {
+	if(Aborted()) {
+		return 0;
+	}
+
+	stats.Nodes++;
+	Counters::QuiescenceNode();
+
+	const auto originalAlpha = alpha;
+	const auto done = [&](int score, TraceReason reason, int best = SearchTrace::NoMove) {
+		if(trace) trace->Record(game.Hash, originalAlpha, beta, score, 0, ply, reason, best);
+		return score;
+	};
+
+	const auto standPat = Evaluate(game, ply);
+	if(ply >= MaxPly) {
+		return done(standPat, TraceReason::StandPat);
+	}
+	if(standPat >= beta) {
+		return done(beta, TraceReason::StandPat);
+	}
+	if(standPat > alpha) {
+		alpha = standPat;
+	}
+
+	const auto moves = OrderMoves(game, game.GetMoves(), true);
+	int searched = 0, best = SearchTrace::NoMove;
 	for(auto& move : moves) {
 		auto cp = game;
 		cp.MakeMove(move);
@@ -278,35 +439,75 @@ static int alphaBeta(ChessEngine& game, int alpha, int beta, int depth) {
 			continue;
 		}
 
-		valid = true;
-		auto score = -alphaBeta(cp, -beta, -alpha, depth - 1);
+		Update(game, cp, ply);
+		if(trace) trace->Enter(ply + 1, move);
+		auto score = -Quiesce(cp, -beta, -alpha, ply + 1);
+		searched++;
+
 		if(score >= beta) {
-			return beta;
+			return done(beta, TraceReason::BetaCutoff, searched - 1);
 		}
 		if(score > alpha) {
 			alpha = score;
+			best = searched - 1;
 		}
 	}
 
-	if(!valid) {
-		if(game.IsCheck()) {
-			return -10000; // Checkmate
-		} else {
-			return 0; // Draw
-		}
+	return done(alpha, alpha > originalAlpha ? TraceReason::Exact : TraceReason::FailLow, best);
+}
+
+int Players::Negamax::AlphaBeta(ChessEngine& game, int alpha, int beta, int depth, int ply) {
+	if(Aborted()) {
+		return 0;
 	}
 
-	return alpha;
-}
+	const auto originalAlpha = alpha;
+	const auto done = [&](int score, TraceReason reason, int best = SearchTrace::NoMove) {
+		if(trace) trace->Record(game.Hash, originalAlpha, beta, score, depth, ply, reason, best);
+		return score;
+	};
 
-Move Players::Negamax::MakeMove(ChessEngine& game) {
-	Move best{};
+	if(game.HalfMoves >= 100 || path.IsRepetition(root)) {
+		return done(0, TraceReason::Draw);
+	}
+
+	if(depth == 0) {
+		return Quiesce(game, alpha, beta, ply);
+	}
+
+	stats.Nodes++;
+	Counters::MainNode();
+
+	if(bitbases && popcnt64(game.occupied) <= 4) {
+		int wdl;
+		if(bitbases->Probe(game, wdl)) {
+			stats.BitbaseHits++;
+			if(wdl == 0) {
+				return done(0, TraceReason::Bitbase);
+			}
+			// the eval still leads the search towards mate inside the won ending
+			return done(wdl * BitbaseWin + Evaluate(game, ply), TraceReason::Bitbase);
+		}
+	}
 
-	int alpha = -1000000;
-	int beta = 1000000;
+	TranspositionEntry entry;
+	Move hashMove{};
+	if(table->Probe(game.Hash, entry)) {
+		hashMove = entry.Best;
 
-	auto moves = game.GetMoves();
+		if(entry.Depth >= depth) {
+			const auto score = ScoreFromTable(entry.Score, ply);
+			if(entry.Type == Bound::Exact) return done(std::clamp(score, alpha, beta), TraceReason::TableCutoff);
+			if(entry.Type == Bound::Lower && score >= beta) return done(beta, TraceReason::TableCutoff);
+			if(entry.Type == Bound::Upper && score <= alpha) return done(alpha, TraceReason::TableCutoff);
+		}
+	}
 
+	Move best{};
+	int bestIndex = SearchTrace::NoMove;
+
+	const auto moves = OrderMoves(game, game.GetMoves(), false, hashMove);
+	int searched = 0;
 	for(auto& move : moves) {
 		auto cp = game;
 		cp.MakeMove(move);
@@ -315,12 +516,272 @@ Move Players::Negamax::MakeMove(ChessEngine& game) {
 			continue;
 		}
 
-		auto score = -alphaBeta(cp, -beta, -alpha, depth);
+		searched++;
+		Update(game, cp, ply);
+		if(trace) trace->Enter(ply + 1, move);
+		path.Push(cp);
+		auto score = -AlphaBeta(cp, -beta, -alpha, depth - 1, ply + 1);
+		path.Pop();
+
+		if(aborted) {
+			return 0;
+		}
+		if(score >= beta) {
+			Counters::Cutoff(searched - 1);
+			table->Store(game.Hash, move, ScoreToTable(beta, ply), depth, Bound::Lower);
+			return done(beta, TraceReason::BetaCutoff, searched - 1);
+		}
 		if(score > alpha) {
 			alpha = score;
 			best = move;
+			bestIndex = searched - 1;
 		}
 	}
 
+	if(!searched) {
+		if(game.IsCheck()) {
+			return done(-MateScore + ply, TraceReason::Checkmate);
+		} else {
+			return done(0, TraceReason::Stalemate);
+		}
+	}
+
+	table->Store(game.Hash, best, ScoreToTable(alpha, ply), depth, alpha > originalAlpha ? Bound::Exact : Bound::Upper);
+	return done(alpha, alpha > originalAlpha ? TraceReason::Exact : TraceReason::FailLow, bestIndex);
+}
+
+std::vector<Move> Players::Negamax::PrincipalVariation(const ChessEngine& game, Move first) {
+	std::vector<Move> line;
+
+	// follow the hash moves after the first move
+	auto position = game;
+	auto move = first;
+	TranspositionEntry entry;
+	while(line.size() < MaxPly) {
+		auto found = false;
+		for(auto m : position.GetMoves()) {
+			if(m == move && m.Type == move.Type) {
+				auto cp = position;
+				cp.MakeMove(m);
+				if(cp.IsValid()) {
+					position = cp;
+					found = true;
+				}
+				break;
+			}
+		}
+		if(!found) break;
+
+		line.push_back(move);
+
+		// a repetition would loop forever
+		if(std::count(line.begin(), line.end(), move) > 2 || !table->Probe(position.Hash, entry)) break;
+		move = entry.Best;
+	}
+
+	return line;
+}
+
+Move Players::Negamax::MakeMove(ChessEngine& game) {
+	if(!clock) {
+		return Search(game, Limits);
+	}
+
+	auto limits = Limits;
+	limits.SetClock((game.WhiteMove ? clock->White : clock->Black).count(), clock->Increment.count(), 0, std::chrono::milliseconds(10));
+	return Search(game, limits);
+}
+
+Move Players::Negamax::Search(ChessEngine& game, const SearchLimits& limits) {
+	if(Threads <= 1) {
+		return IterativeDeepening(game, limits);
+	}
+
+	while(helpers.size() < Threads - 1) {
+		auto helper = std::make_unique<Negamax>();
+		helper->table = table;
+		helper->firstIteration = (helpers.size() + 1) % 2;
+		helpers.push_back(std::move(helper));
+	}
+	helpers.resize(Threads - 1);
+
+	for(auto& helper : helpers) {
+		helper->Stop = false;
+		helper->UseNetwork(network);
+		helper->UseBitbases(bitbases);
+		helper->SetHistory(history);
+	}
+
+	// the helpers search without limits until the main thread is done
+	SearchLimits helperLimits;
+	helperLimits.Infinite = true;
+	Move best;
+
+#pragma omp parallel num_threads(Threads)
+	{
+		const auto thread = omp_get_thread_num();
+		if(thread == 0) {
+			best = IterativeDeepening(game, limits);
+			for(auto& helper : helpers) {
+				helper->Stop = true;
+			}
+		} else if(thread <= helpers.size()) {
+			auto position = game;
+			helpers[thread - 1]->IterativeDeepening(position, helperLimits);
+		}
+	}
+
+	for(const auto& helper : helpers) {
+		stats.Nodes += helper->stats.Nodes;
+		stats.BitbaseHits += helper->stats.BitbaseHits;
+	}
+	return best;
+}
+
+Move Players::Negamax::IterativeDeepening(ChessEngine& game, const SearchLimits& limits) {
+	this->limits = limits;
+	timer = TimeManager(limits);
+	aborted = false;
+	pondering = Ponder;
+
+	auto maxDepth = depth;
+	if(limits.Depth >= 0) {
+		maxDepth = limits.Depth;
+	} else if(limits.Infinite || limits.Nodes || limits.Hard.count() || pondering) {
+		maxDepth = MaxPly;
+	}
+
+	stats = {};
+	const auto pawnProbes = pawnTable.Probes;
+	const auto pawnHits = pawnTable.Hits;
+
+	if(network) {
+		network->Refresh(game, accumulators[0]);
+	}
+
+	if(history && history->Size()) {
+		path = *history;
+	} else {
+		path.Clear();
+		path.Push(game);
+	}
+	root = path.Size() - 1;
+
+	TranspositionEntry entry;
+	auto moves = OrderMoves(game, game.GetMoves(), false, table->Probe(game.Hash, entry) ? entry.Best : Move());
+	Move best{};
+	pv.clear();
+
+	const auto same = [](const Move a, const Move b) { return a == b && a.Type == b.Type; };
+
+	// iterative deepening, the lines of the previous iteration are searched first
+	for(int iteration = firstIteration; iteration <= std::min(maxDepth, MaxPly - 2); iteration++) {
+		// every further line searches the root without the moves of the lines before it
+		std::vector<Move> lines;
+
+		for(int line = 0; line < std::max(MultiPv, 1); line++) {
+			int alpha = -1000000;
+			int beta = 1000000;
+			Move lineBest{};
+			int searched = 0, bestIndex = SearchTrace::NoMove;
+
+			for(auto& move : moves) {
+				if(std::any_of(lines.begin(), lines.end(), [&](const Move m) { return same(m, move); })) {
+					continue;
+				}
+
+				auto cp = game;
+				cp.MakeMove(move);
+
+				if(!cp.IsValid()) {
+					continue;
+				}
+
+				Update(game, cp, 0);
+				if(trace) trace->Enter(1, move);
+				path.Push(cp);
+				auto score = -AlphaBeta(cp, -beta, -alpha, iteration, 1);
+				path.Pop();
+				searched++;
+
+				if(Aborted()) {
+					break;
+				}
+				if(score > alpha) {
+					alpha = score;
+					lineBest = move;
+					bestIndex = searched - 1;
+				}
+			}
+
+			// moves are searched fully or not at all, so a partial iteration still improves on the last one
+			if(line == 0 && lineBest.Type != MoveType::Error) {
+				best = lineBest;
+			}
+
+			// no moves left for more lines
+			if(Aborted() || lineBest.Type == MoveType::Error) {
+				break;
+			}
+
+			if(trace) trace->Record(game.Hash, -1000000, 1000000, alpha, iteration + 1, 0, TraceReason::Root, bestIndex);
+
+			lines.push_back(lineBest);
+			auto linePv = PrincipalVariation(game, lineBest);
+
+			if(line == 0) {
+				table->Store(game.Hash, best, alpha, iteration + 1, Bound::Exact);
+				pv = linePv;
+			}
+
+			if(OnIteration) {
+				OnIteration({ iteration + 1, line + 1, alpha, linePv, stats.Nodes, timer.Elapsed() });
+			}
+		}
+
+		if(lines.empty() && best.Type != MoveType::Error) {
+			lines.push_back(best);
+		}
+
+		Test ordered;
+		for(const auto move : lines) {
+			ordered.push(move);
+		}
+		for(const auto move : moves) {
+			if(std::none_of(lines.begin(), lines.end(), [&](const Move m) { return same(m, move); })) {
+				ordered.push(move);
+			}
+		}
+		moves = ordered;
+
+		if(Aborted()) {
+			break;
+		}
+
+		// while pondering the search only ends through stop or ponderhit
+		if(!timer.NextIteration(best) && !pondering) {
+			break;
+		}
+	}
+
+	// out of time before the first move was searched
+	if(best.Type == MoveType::Error) {
+		for(auto& move : moves) {
+			auto cp = game;
+			cp.MakeMove(move);
+			if(cp.IsValid()) {
+				best = move;
+				break;
+			}
+		}
+	}
+
+	if(pv.empty() || !(pv[0] == best)) {
+		pv.assign(1, best);
+	}
+
+	stats.PawnProbes = pawnTable.Probes - pawnProbes;
+	stats.PawnHits = pawnTable.Hits - pawnHits;
+
 	return best;
 }
@@ -1,13 +1,117 @@
 #pragma once
 #include "Player.h"
+#include "PawnTable.h"
+#include "SearchTrace.h"
+#include "Nnue.h"
+#include "TimeManager.h"
+#include "TranspositionTable.h"
+#include "../Engine/Bitbase.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+int eval(const ChessEngine& g, PawnTable& pawns);
+
+// Values of the PeSTO evaluation for piece types 0 to 5 (pawn to king) and squares from a8 to h1 seen from white
+int PestoMaterial(bool endgame, int piece);
+int PestoSquare(bool endgame, int piece, int square);
+int PestoPhase(int piece);
 
 namespace Players {
+	// Mate in n plies from the root scores MateScore - n, scores beyond MateBound are mates
+	constexpr int MateScore = 10000;
+	constexpr int MateBound = MateScore - 256;
+
+	struct SearchStats {
+		uint64_t Nodes = 0;
+		uint64_t PawnProbes = 0;
+		uint64_t PawnHits = 0;
+		uint64_t BitbaseHits = 0;
+	};
+
+	// Reported after every completed iteration
+	struct SearchInfo {
+		int Depth;
+		int MultiPv;
+		int Score;
+		const std::vector<Move>& Pv;
+		uint64_t Nodes;
+		std::chrono::milliseconds Time;
+	};
+
 	class Negamax : public Player {
 
 	public:
+		static constexpr int MaxPly = 128;
+
+		// Set from another thread to end the search, the best move of the last finished iteration is returned
+		std::atomic<bool> Stop = false;
+		// While set the time limits are ignored, clearing it starts the clock
+		std::atomic<bool> Ponder = false;
+		std::function<void(const SearchInfo&)> OnIteration;
+
+		// Number of best lines reported per iteration
+		int MultiPv = 1;
+		// Searching threads, the helpers only share the transposition table with the main thread (lazy SMP)
+		int Threads = 1;
+		// Used by MakeMove together with the clock, a depth of -1 keeps the one given to the constructor
+		SearchLimits Limits;
+
 		Negamax(int depth = 4) : depth(depth) {}
 		Move MakeMove(ChessEngine& game) override;
+		Move Search(ChessEngine& game, const SearchLimits& limits);
+
+		// nullptr switches back to the PeSTO evaluation
+		void UseNetwork(std::shared_ptr<const Nnue::Network> network);
+		void UseBitbases(std::shared_ptr<const Bitbases> bitbases);
+
+		void SetHashSize(size_t megabytes) { table->Resize(megabytes); }
+		// Records every node into a ring buffer file of the given size, an empty path turns it off
+		void SetTrace(const std::string& path, size_t megabytes);
+		void NewGame();
+
+		const SearchStats& Stats() const { return stats; }
+		// Best line of the last search, the second move is the expected reply
+		const std::vector<Move>& Pv() const { return pv; }
 	private:
 		int depth;
+		SearchStats stats;
+
+		SearchLimits limits;
+		TimeManager timer;
+		bool aborted = false;
+		bool pondering = false;
+
+		std::shared_ptr<TranspositionTable> table = std::make_shared<TranspositionTable>();
+		std::vector<Move> pv;
+		PawnTable pawnTable;
+
+		std::shared_ptr<const Nnue::Network> network;
+		std::vector<Nnue::Accumulator> accumulators;
+		std::shared_ptr<const Bitbases> bitbases;
+		std::unique_ptr<SearchTrace> trace;
+
+		// game history followed by the current search path
+		History path;
+		size_t root = 0;
+
+		std::vector<std::unique_ptr<Negamax>> helpers;
+		// helpers start at different depths so they don't all search the same tree
+		int firstIteration = 0;
+
+		// Stop, node or time limit reached
+		bool Aborted();
+
+		std::vector<Move> PrincipalVariation(const ChessEngine& game, Move first);
+		Move IterativeDeepening(ChessEngine& game, const SearchLimits& limits);
+
+		int Evaluate(const ChessEngine& game, int ply);
+		void Update(const ChessEngine& parent, const ChessEngine& child, int ply);
+
+		int AlphaBeta(ChessEngine& game, int alpha, int beta, int depth, int ply);
+		int Quiesce(ChessEngine& game, int alpha, int beta, int ply);
 	};
 }
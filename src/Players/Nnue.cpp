@@ -0,0 +1,425 @@
+#include "Nnue.h"
+#include "Negamax.h"
+#include "Platform.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include <omp.h>
+
+using namespace Nnue;
+
+constexpr uint32_t FileMagic = 0x45554E4E; // "NNUE"
+constexpr uint32_t FileVersion = 1;
+
+static int FeatureIndex(int perspective, int kingSquare, int type, int color, int square) {
+	if(perspective == 1) {
+		kingSquare ^= 56;
+		square ^= 56;
+	}
+	const int piece = type * 2 + (color != perspective);
+	return (kingSquare * 10 + piece) * 64 + square;
+}
+
+#pragma region Kernels
+#if __AVX2__
+
+constexpr const char* KernelName = "avx2";
+
+static void AddFeature(int16_t* acc, const int16_t* weights) {
+	for(int i = 0; i < Hidden; i += 16) {
+		auto a = _mm256_load_si256((const __m256i*)(acc + i));
+		auto w = _mm256_loadu_si256((const __m256i*)(weights + i));
+		_mm256_store_si256((__m256i*)(acc + i), _mm256_add_epi16(a, w));
+	}
+}
+
+static void SubFeature(int16_t* acc, const int16_t* weights) {
+	for(int i = 0; i < Hidden; i += 16) {
+		auto a = _mm256_load_si256((const __m256i*)(acc + i));
+		auto w = _mm256_loadu_si256((const __m256i*)(weights + i));
+		_mm256_store_si256((__m256i*)(acc + i), _mm256_sub_epi16(a, w));
+	}
+}
+
+// int16 -> [0, 127]
+static void ClippedReLU(const int16_t* in, uint8_t* out, int count) {
+	const auto zero = _mm256_setzero_si256();
+
+	for(int i = 0; i < count; i += 32) {
+		auto a = _mm256_load_si256((const __m256i*)(in + i));
+		auto b = _mm256_load_si256((const __m256i*)(in + i + 16));
+		// packs works per 128 bit lane, permute restores the order
+		auto packed = _mm256_max_epi8(_mm256_packs_epi16(a, b), zero);
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_permute4x64_epi64(packed, 0b11011000));
+	}
+}
+
+static int32_t Dot(const uint8_t* input, const int8_t* weights, int count) {
+	const auto ones = _mm256_set1_epi16(1);
+	auto sum = _mm256_setzero_si256();
+
+	for(int i = 0; i < count; i += 32) {
+		auto a = _mm256_loadu_si256((const __m256i*)(input + i));
+		auto w = _mm256_loadu_si256((const __m256i*)(weights + i));
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(a, w), ones));
+	}
+
+	auto lo = _mm256_castsi256_si128(sum);
+	auto hi = _mm256_extracti128_si256(sum, 1);
+	auto s = _mm_add_epi32(lo, hi);
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0b01001110));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0b10110001));
+	return _mm_cvtsi128_si32(s);
+}
+
+// four outputs at a time so the horizontal sums can be shared
+static void Dense(const uint8_t* input, int inputs, const int8_t* weights, const int32_t* bias, uint8_t* output, int outputs) {
+	const auto ones = _mm256_set1_epi16(1);
+
+	for(int i = 0; i < outputs; i += 4) {
+		__m256i sum[4];
+		for(int k = 0; k < 4; k++) {
+			sum[k] = _mm256_setzero_si256();
+		}
+
+		for(int j = 0; j < inputs; j += 32) {
+			const auto a = _mm256_loadu_si256((const __m256i*)(input + j));
+
+			for(int k = 0; k < 4; k++) {
+				const auto w = _mm256_loadu_si256((const __m256i*)(weights + (i + k) * inputs + j));
+				sum[k] = _mm256_add_epi32(sum[k], _mm256_madd_epi16(_mm256_maddubs_epi16(a, w), ones));
+			}
+		}
+
+		auto s = _mm256_hadd_epi32(_mm256_hadd_epi32(sum[0], sum[1]), _mm256_hadd_epi32(sum[2], sum[3]));
+		auto total = _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+		total = _mm_srai_epi32(_mm_add_epi32(total, _mm_loadu_si128((const __m128i*)(bias + i))), WeightShift);
+
+		// int32 -> [0, 127]
+		const auto packed = _mm_packs_epi16(_mm_packs_epi32(total, total), _mm_setzero_si128());
+		const auto clipped = _mm_max_epi8(packed, _mm_setzero_si128());
+		std::memcpy(output + i, &clipped, 4);
+	}
+}
+
+#else
+
+constexpr const char* KernelName = "scalar";
+
+static void AddFeature(int16_t* acc, const int16_t* weights) {
+	for(int i = 0; i < Hidden; i++) {
+		acc[i] += weights[i];
+	}
+}
+
+static void SubFeature(int16_t* acc, const int16_t* weights) {
+	for(int i = 0; i < Hidden; i++) {
+		acc[i] -= weights[i];
+	}
+}
+
+static void ClippedReLU(const int16_t* in, uint8_t* out, int count) {
+	for(int i = 0; i < count; i++) {
+		out[i] = std::clamp<int>(in[i], 0, 127);
+	}
+}
+
+static int32_t Dot(const uint8_t* input, const int8_t* weights, int count) {
+	int32_t sum = 0;
+	for(int i = 0; i < count; i++) {
+		sum += input[i] * weights[i];
+	}
+	return sum;
+}
+
+static void Dense(const uint8_t* input, int inputs, const int8_t* weights, const int32_t* bias, uint8_t* output, int outputs) {
+	for(int i = 0; i < outputs; i++) {
+		const auto sum = bias[i] + Dot(input, weights + i * inputs, inputs);
+		output[i] = std::clamp(sum >> WeightShift, 0, 127);
+	}
+}
+
+#endif
+
+#pragma endregion
+
+Network::Network() :
+	ftBias(Hidden), ftWeights((size_t)Inputs * Hidden),
+	l2Bias(L2), l2Weights(L2 * 2 * Hidden),
+	l3Bias(L3), l3Weights(L3 * L2),
+	outBias(0), outWeights(L3) {
+
+	// Hidden neuron t counts own pieces of type t, neuron 5 + t the enemy ones.
+	// The scale keeps the usual piece counts below the clipping limit.
+	constexpr int scale[5] = { 15, 40, 40, 40, 60 };
+	// centipawns * 64 / (10 * scale), so the second layer works in units of 10cp
+	constexpr int value[5] = { 38, 49, 53, 79, 105 };
+
+	for(int king = 0; king < 64; king++) {
+		for(int type = 0; type < 5; type++) {
+			for(int square = 0; square < 64; square++) {
+				const auto own = FeatureIndex(0, king, type, 0, square);
+				const auto enemy = FeatureIndex(0, king, type, 1, square);
+
+				ftWeights[(size_t)own * Hidden + type] = scale[type];
+				ftWeights[(size_t)enemy * Hidden + 5 + type] = scale[type];
+			}
+		}
+	}
+
+	// Neuron k is the material balance clipped to [1270k, 1270(k + 1)], neuron 4 + k the same for the negated balance
+	for(int k = 0; k < 4; k++) {
+		for(int type = 0; type < 5; type++) {
+			l2Weights[k * 2 * Hidden + type] = value[type];
+			l2Weights[k * 2 * Hidden + 5 + type] = -value[type];
+			l2Weights[(4 + k) * 2 * Hidden + type] = -value[type];
+			l2Weights[(4 + k) * 2 * Hidden + 5 + type] = value[type];
+		}
+		l2Bias[k] = -127 * k << WeightShift;
+		l2Bias[4 + k] = -127 * k << WeightShift;
+	}
+
+	for(int i = 0; i < 8; i++) {
+		l3Weights[i * L2 + i] = 1 << WeightShift;
+		outWeights[i] = i < 4 ? 10 * OutputDivisor : -10 * OutputDivisor;
+	}
+}
+
+template<class T>
+static void Read(std::ifstream& file, std::vector<T>& data) {
+	file.read((char*)data.data(), data.size() * sizeof(T));
+}
+
+template<class T>
+static void Write(std::ofstream& file, const std::vector<T>& data) {
+	file.write((const char*)data.data(), data.size() * sizeof(T));
+}
+
+Network::Network(const std::string& path) :
+	ftBias(Hidden), ftWeights((size_t)Inputs * Hidden),
+	l2Bias(L2), l2Weights(L2 * 2 * Hidden),
+	l3Bias(L3), l3Weights(L3 * L2),
+	outBias(0), outWeights(L3) {
+
+	std::ifstream file(path, std::ios::binary);
+	if(!file) {
+		throw std::runtime_error("Can't open network file " + path);
+	}
+
+	uint32_t header[6];
+	file.read((char*)header, sizeof(header));
+
+	if(header[0] != FileMagic || header[1] != FileVersion) {
+		throw std::runtime_error("Not a network file " + path);
+	}
+	if(header[2] != Inputs || header[3] != Hidden || header[4] != L2 || header[5] != L3) {
+		throw std::runtime_error("Network architecture mismatch in " + path);
+	}
+
+	Read(file, ftBias);
+	Read(file, ftWeights);
+	Read(file, l2Bias);
+	Read(file, l2Weights);
+	Read(file, l3Bias);
+	Read(file, l3Weights);
+	file.read((char*)&outBias, sizeof(outBias));
+	Read(file, outWeights);
+
+	if(!file) {
+		throw std::runtime_error("Network file is truncated " + path);
+	}
+}
+
+void Network::Save(const std::string& path) const {
+	std::ofstream file(path, std::ios::binary);
+
+	const uint32_t header[6] = { FileMagic, FileVersion, Inputs, Hidden, L2, L3 };
+	file.write((const char*)header, sizeof(header));
+
+	Write(file, ftBias);
+	Write(file, ftWeights);
+	Write(file, l2Bias);
+	Write(file, l2Weights);
+	Write(file, l3Bias);
+	Write(file, l3Weights);
+	file.write((const char*)&outBias, sizeof(outBias));
+	Write(file, outWeights);
+}
+
+void Network::RefreshPerspective(const ChessEngine& game, int perspective, Accumulator& acc) const {
+	auto values = acc.Values[perspective];
+	std::memcpy(values, ftBias.data(), sizeof(int16_t) * Hidden);
+
+	const auto king = NumberOfTrailingZeros(game.K & (perspective == 0 ? game.White : game.Black));
+	const uint64_t types[5] = { game.P, game.N, game.B, game.R, game.Q };
+
+	for(int type = 0; type < 5; type++) {
+		for(int color = 0; color < 2; color++) {
+			auto board = types[type] & (color == 0 ? game.White : game.Black);
+
+			while(board) {
+				const auto index = FeatureIndex(perspective, king, type, color, NumberOfTrailingZeros(board));
+				AddFeature(values, &ftWeights[(size_t)index * Hidden]);
+				board &= board - 1;
+			}
+		}
+	}
+}
+
+void Network::Refresh(const ChessEngine& game, Accumulator& acc) const {
+	RefreshPerspective(game, 0, acc);
+	RefreshPerspective(game, 1, acc);
+}
+
+void Network::Update(const ChessEngine& before, const ChessEngine& after, const Accumulator& parent, Accumulator& child) const {
+	const uint64_t typesBefore[5] = { before.P, before.N, before.B, before.R, before.Q };
+	const uint64_t typesAfter[5] = { after.P, after.N, after.B, after.R, after.Q };
+
+	for(int perspective = 0; perspective < 2; perspective++) {
+		const auto kingBefore = before.K & (perspective == 0 ? before.White : before.Black);
+		const auto kingAfter = after.K & (perspective == 0 ? after.White : after.Black);
+
+		// every feature depends on the king square
+		if(kingBefore != kingAfter) {
+			RefreshPerspective(after, perspective, child);
+			continue;
+		}
+
+		auto values = child.Values[perspective];
+		std::memcpy(values, parent.Values[perspective], sizeof(int16_t) * Hidden);
+
+		const auto king = NumberOfTrailingZeros(kingAfter);
+
+		for(int type = 0; type < 5; type++) {
+			for(int color = 0; color < 2; color++) {
+				const auto old = typesBefore[type] & (color == 0 ? before.White : before.Black);
+				const auto now = typesAfter[type] & (color == 0 ? after.White : after.Black);
+
+				auto removed = old & ~now;
+				auto added = now & ~old;
+
+				while(removed) {
+					const auto index = FeatureIndex(perspective, king, type, color, NumberOfTrailingZeros(removed));
+					SubFeature(values, &ftWeights[(size_t)index * Hidden]);
+					removed &= removed - 1;
+				}
+				while(added) {
+					const auto index = FeatureIndex(perspective, king, type, color, NumberOfTrailingZeros(added));
+					AddFeature(values, &ftWeights[(size_t)index * Hidden]);
+					added &= added - 1;
+				}
+			}
+		}
+	}
+}
+
+int Network::Evaluate(const Accumulator& acc, bool whiteMove) const {
+	alignas(32) uint8_t input[2 * Hidden];
+	alignas(32) uint8_t hidden2[L2];
+	alignas(32) uint8_t hidden3[L3];
+
+	const int us = whiteMove ? 0 : 1;
+	ClippedReLU(acc.Values[us], input, Hidden);
+	ClippedReLU(acc.Values[us ^ 1], input + Hidden, Hidden);
+
+	Dense(input, 2 * Hidden, l2Weights.data(), l2Bias.data(), hidden2, L2);
+	Dense(hidden2, L2, l3Weights.data(), l3Bias.data(), hidden3, L3);
+
+	return (outBias + Dot(hidden3, outWeights.data(), L3)) / OutputDivisor;
+}
+
+template<class F>
+static double Measure(int seconds, F&& func) {
+	uint64_t count = 0;
+	auto begin = std::chrono::high_resolution_clock::now();
+	double passed;
+
+	do {
+		count += func();
+		passed = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::high_resolution_clock::now() - begin).count();
+	} while(passed < seconds);
+
+	return count / passed;
+}
+
+void Nnue::Benchmark(const Network& network, int seconds) {
+	// positions from random games with a fixed seed
+	std::vector<ChessEngine> positions;
+	std::mt19937 rng(1234);
+
+	while(positions.size() < 10000) {
+		ChessEngine game;
+		for(int ply = 0; ply < 120; ply++) {
+			auto moves = game.GetValidMoves();
+			if(moves.empty()) break;
+
+			game.MakeMove(moves[rng() % moves.size()]);
+			positions.push_back(game);
+		}
+	}
+
+	// refreshing the accumulator and evaluating it
+	auto refresh = [&]() {
+		Accumulator acc;
+		int64_t sum = 0;
+		for(auto& pos : positions) {
+			network.Refresh(pos, acc);
+			sum += network.Evaluate(acc, pos.WhiteMove);
+		}
+		DoNotOptimize(sum);
+		return positions.size();
+	};
+
+	// the search pattern: update from the parent for every child and evaluate it
+	auto incremental = [&]() {
+		Accumulator parent, child;
+		int64_t sum = 0;
+		uint64_t count = 0;
+		for(size_t i = 0; i < positions.size(); i += 10) {
+			auto& pos = positions[i];
+			network.Refresh(pos, parent);
+
+			for(auto move : pos.GetMoves()) {
+				auto cp = pos;
+				cp.MakeMove(move);
+				if(!cp.IsValid()) continue;
+
+				network.Update(pos, cp, parent, child);
+				sum += network.Evaluate(child, cp.WhiteMove);
+				count++;
+			}
+		}
+		DoNotOptimize(sum);
+		return count;
+	};
+
+	auto pesto = [&]() {
+		PawnTable pawns;
+		int64_t sum = 0;
+		for(auto& pos : positions) {
+			sum += eval(pos, pawns);
+		}
+		DoNotOptimize(sum);
+		return positions.size();
+	};
+
+	std::cout << "Kernels: " << KernelName << "\n";
+	std::cout << "Evals per second on one core\n";
+	std::cout << "PeSTO:              " << (int64_t)Measure(seconds, pesto) << "\n";
+	std::cout << "NNUE refresh:       " << (int64_t)Measure(seconds, refresh) << "\n";
+	std::cout << "NNUE incremental:   " << (int64_t)Measure(seconds, incremental) << "\n";
+
+	const int threads = omp_get_max_threads();
+	double total = 0;
+
+#pragma omp parallel reduction(+:total)
+	total += Measure(seconds, incremental);
+
+	std::cout << "NNUE incremental on " << threads << " threads: " << (int64_t)(total / threads) << " per core\n";
+}
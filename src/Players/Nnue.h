@@ -0,0 +1,48 @@
+#pragma once
+#include "../Engine/ChessEngine.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Nnue {
+	// HalfKP: own king square x (piece type, color relative to the perspective, square)
+	constexpr int Inputs = 64 * 10 * 64;
+	constexpr int Hidden = 128;
+	constexpr int L2 = 32;
+	constexpr int L3 = 32;
+
+	constexpr int WeightShift = 6;
+	constexpr int OutputDivisor = 8;
+
+	struct Accumulator {
+		// indexed by perspective, 0 = white, 1 = black
+		alignas(32) int16_t Values[2][Hidden];
+	};
+
+	class Network {
+	public:
+		// Built in network which only knows about material
+		Network();
+		Network(const std::string& path);
+
+		void Save(const std::string& path) const;
+
+		void Refresh(const ChessEngine& game, Accumulator& acc) const;
+		void Update(const ChessEngine& before, const ChessEngine& after, const Accumulator& parent, Accumulator& child) const;
+		int Evaluate(const Accumulator& acc, bool whiteMove) const;
+	private:
+		std::vector<int16_t> ftBias;
+		std::vector<int16_t> ftWeights;
+		std::vector<int32_t> l2Bias;
+		std::vector<int8_t> l2Weights;
+		std::vector<int32_t> l3Bias;
+		std::vector<int8_t> l3Weights;
+		int32_t outBias;
+		std::vector<int8_t> outWeights;
+
+		void RefreshPerspective(const ChessEngine& game, int perspective, Accumulator& acc) const;
+	};
+
+	void Benchmark(const Network& network, int seconds);
+}
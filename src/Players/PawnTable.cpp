@@ -0,0 +1,131 @@
+#include "PawnTable.h"
+#include "Platform.h"
+
+#include "../Engine/ChessConstants.h"
+
+#include <algorithm>
+
+// indexed by rank relative to the pawn owner
+constexpr int16_t passedMg[8] = { 0, 2, 8, 12, 28, 52, 86, 0 };
+constexpr int16_t passedEg[8] = { 0, 10, 16, 24, 42, 78, 130, 0 };
+
+constexpr int16_t doubledMg = -8, doubledEg = -22;
+constexpr int16_t isolatedMg = -6, isolatedEg = -14;
+constexpr int16_t backwardMg = -8, backwardEg = -12;
+
+static uint64_t NorthFill(uint64_t b) {
+	b |= b << 8;
+	b |= b << 16;
+	b |= b << 32;
+	return b;
+}
+
+static uint64_t SouthFill(uint64_t b) {
+	b |= b >> 8;
+	b |= b >> 16;
+	b |= b >> 32;
+	return b;
+}
+
+// toward the h file / the a file
+static uint64_t EastOne(uint64_t b) { return (b >> 1) & ~FileA; }
+static uint64_t WestOne(uint64_t b) { return (b << 1) & ~FileH; }
+
+static int Rank(uint64_t bit) {
+	return NumberOfTrailingZeros(bit) / 8;
+}
+
+PawnEntry EvalPawns(uint64_t whitePawns, uint64_t blackPawns) {
+	int mg = 0, eg = 0;
+
+	const auto whiteFiles = NorthFill(SouthFill(whitePawns));
+	const auto blackFiles = NorthFill(SouthFill(blackPawns));
+
+	const auto whiteAttacks = EastOne(whitePawns << 8) | WestOne(whitePawns << 8);
+	const auto blackAttacks = EastOne(blackPawns >> 8) | WestOne(blackPawns >> 8);
+
+	#pragma region Passed
+	{
+		const auto blackSpan = SouthFill(blackPawns >> 8);
+		const auto whiteSpan = NorthFill(whitePawns << 8);
+
+		// don't count the rear pawn of a doubled pair as passed
+		auto wp = whitePawns & ~(blackSpan | EastOne(blackSpan) | WestOne(blackSpan)) & ~SouthFill(whitePawns >> 8);
+		auto bp = blackPawns & ~(whiteSpan | EastOne(whiteSpan) | WestOne(whiteSpan)) & ~NorthFill(blackPawns << 8);
+
+		while(wp) {
+			const auto rank = Rank(wp);
+			mg += passedMg[rank];
+			eg += passedEg[rank];
+			wp &= wp - 1;
+		}
+		while(bp) {
+			const auto rank = 7 - Rank(bp);
+			mg -= passedMg[rank];
+			eg -= passedEg[rank];
+			bp &= bp - 1;
+		}
+	}
+	#pragma endregion
+
+	#pragma region Doubled
+	{
+		const int white = popcnt64(whitePawns & NorthFill(whitePawns << 8));
+		const int black = popcnt64(blackPawns & SouthFill(blackPawns >> 8));
+
+		mg += (white - black) * doubledMg;
+		eg += (white - black) * doubledEg;
+	}
+	#pragma endregion
+
+	#pragma region Isolated
+	const auto whiteIsolated = whitePawns & ~(EastOne(whiteFiles) | WestOne(whiteFiles));
+	const auto blackIsolated = blackPawns & ~(EastOne(blackFiles) | WestOne(blackFiles));
+	{
+		const int white = popcnt64(whiteIsolated);
+		const int black = popcnt64(blackIsolated);
+
+		mg += (white - black) * isolatedMg;
+		eg += (white - black) * isolatedEg;
+	}
+	#pragma endregion
+
+	#pragma region Backward
+	{
+		// stop square is attacked by an enemy pawn and no own pawn can ever defend it
+		const auto whiteSupport = NorthFill(whiteAttacks);
+		const auto blackSupport = SouthFill(blackAttacks);
+
+		const auto white = ((whitePawns << 8) & blackAttacks & ~whiteSupport) >> 8 & ~whiteIsolated;
+		const auto black = ((blackPawns >> 8) & whiteAttacks & ~blackSupport) << 8 & ~blackIsolated;
+
+		mg += (int)(popcnt64(white) - popcnt64(black)) * backwardMg;
+		eg += (int)(popcnt64(white) - popcnt64(black)) * backwardEg;
+	}
+	#pragma endregion
+
+	PawnEntry entry;
+	entry.Mg = mg;
+	entry.Eg = eg;
+	return entry;
+}
+
+const PawnEntry& PawnTable::Probe(const ChessEngine& game) {
+	auto& entry = entries[game.PawnHash & mask];
+	Probes++;
+
+	if(entry.Key == game.PawnHash) {
+		Hits++;
+		return entry;
+	}
+
+	entry = EvalPawns(game.P & game.White, game.P & game.Black);
+	entry.Key = game.PawnHash;
+	return entry;
+}
+
+void PawnTable::Clear() {
+	std::fill(entries.begin(), entries.end(), PawnEntry{});
+	Probes = 0;
+	Hits = 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "../Engine/ChessEngine.h"
+
+#include <vector>
+
+// Pawn structure scores from white's point of view
+struct PawnEntry {
+	uint64_t Key = 0;
+	int16_t Mg = 0;
+	int16_t Eg = 0;
+};
+
+class PawnTable {
+public:
+	uint64_t Probes = 0;
+	uint64_t Hits = 0;
+
+	PawnTable(int bits = 14) : entries(1ULL << bits), mask((1ULL << bits) - 1) {}
+
+	const PawnEntry& Probe(const ChessEngine& game);
+	void Clear();
+private:
+	std::vector<PawnEntry> entries;
+	uint64_t mask;
+};
+
+PawnEntry EvalPawns(uint64_t whitePawns, uint64_t blackPawns);
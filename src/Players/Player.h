@@ -1,5 +1,7 @@
 #pragma once
 #include "../Engine/ChessEngine.h"
+#include "../Engine/History.h"
+#include <chrono>
 #include <climits>
 
 template <typename F>
@@ -25,9 +27,24 @@ auto bestMove(ChessEngine& game, F&& keyFunc) {
 }
 
 namespace Players {
+	// Remaining time of both sides, kept up to date by whoever runs the game
+	struct Clock {
+		std::chrono::milliseconds White{ 0 };
+		std::chrono::milliseconds Black{ 0 };
+		std::chrono::milliseconds Increment{ 0 };
+	};
+
 	class Player {
 	public:
 		virtual ~Player() {}
 		virtual Move MakeMove(ChessEngine& game) { return {}; };
+
+		// Positions of the game so far, the last one is the position passed to MakeMove
+		void SetHistory(const History* history) { this->history = history; }
+		// Time left in the current game, nullptr when moves aren't timed
+		void SetClock(const Clock* clock) { this->clock = clock; }
+	protected:
+		const History* history = nullptr;
+		const Clock* clock = nullptr;
 	};
 }
@@ -1,9 +1,15 @@
 #pragma once
 #include "Player.h"
 
+#include <random>
+
 namespace Players {
 	class Random : public Player {
 	public:
+		Random(uint64_t seed = std::random_device()()) : rng(seed) {}
+
 		Move MakeMove(ChessEngine& game) override;
+	private:
+		std::mt19937_64 rng;
 	};
 }
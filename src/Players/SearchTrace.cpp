@@ -0,0 +1,196 @@
+#include "SearchTrace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+constexpr char Magic[4] = { 'C', 'T', 'R', 'C' };
+constexpr uint32_t Version = 1;
+
+static const char* ReasonNames[] = {
+	"exact", "fail low", "beta cutoff", "table cutoff", "draw", "bitbase", "checkmate", "stalemate", "stand pat", "root"
+};
+
+static int16_t Clamp(int score) {
+	return (int16_t)std::clamp(score, -32767, 32767);
+}
+
+Players::SearchTrace::SearchTrace(const std::string& path, size_t megabytes)
+	: file(path, sizeof(TraceHeader) + std::max<size_t>(megabytes * 1024 * 1024 / sizeof(TraceRecord), 1) * sizeof(TraceRecord)) {
+	header = (TraceHeader*)file.MutableData();
+	records = (TraceRecord*)(file.MutableData() + sizeof(TraceHeader));
+
+	std::memcpy(header->Magic, Magic, sizeof(Magic));
+	header->Version = Version;
+	header->RecordSize = sizeof(TraceRecord);
+	header->Capacity = (file.Size() - sizeof(TraceHeader)) / sizeof(TraceRecord);
+	header->Written = 0;
+}
+
+void Players::SearchTrace::Record(uint64_t key, int alpha, int beta, int score, int depth, int ply, TraceReason reason, int best) {
+	auto& record = records[header->Written % header->Capacity];
+	record.Key = key;
+	record.Alpha = Clamp(alpha);
+	record.Beta = Clamp(beta);
+	record.Score = Clamp(score);
+	record.Depth = (uint8_t)depth;
+	record.Ply = (uint8_t)ply;
+	record.Played = ply ? moves[ply] : Move();
+	record.Reason = reason;
+	record.Best = (uint8_t)std::min(best, (int)NoMove);
+	header->Written++;
+}
+
+#pragma region Reader
+
+// children of the node at index, the closest one first
+static std::vector<size_t> Children(const std::vector<Players::TraceRecord>& records, size_t index) {
+	std::vector<size_t> children;
+	const auto ply = records[index].Ply;
+
+	for(size_t i = index; i-- > 0;) {
+		if(records[i].Ply <= ply) break;
+		if(records[i].Ply == ply + 1) children.push_back(i);
+	}
+	return children;
+}
+
+static void PrintTree(const std::vector<Players::TraceRecord>& records, size_t index, int levels, int indent) {
+	const auto& record = records[index];
+
+	std::cout << std::string(indent * 2, ' ');
+	if(record.Ply) {
+		std::cout << record.Played << " ";
+	}
+	std::cout << "score " << record.Score << " [" << record.Alpha << ", " << record.Beta << "] depth " << (int)record.Depth
+		<< " " << ReasonNames[(int)record.Reason];
+	if(record.Best != Players::SearchTrace::NoMove) {
+		std::cout << " best #" << record.Best + 1;
+	}
+
+	// searched order is the reverse of the record order
+	auto children = Children(records, index);
+	std::cout << " (" << children.size() << " children) key " << std::hex << record.Key << std::dec << "\n";
+
+	if(levels > 0) {
+		for(auto it = children.rbegin(); it != children.rend(); ++it) {
+			PrintTree(records, *it, levels - 1, indent + 1);
+		}
+	}
+}
+
+void Players::AnalyzeTrace(const std::string& path, uint64_t key, int levels) {
+	MappedFile file(path);
+
+	if(file.Size() < sizeof(TraceHeader)) {
+		throw std::runtime_error("Not a search trace: " + path);
+	}
+	TraceHeader header;
+	std::memcpy(&header, file.Data(), sizeof(header));
+	if(std::memcmp(header.Magic, Magic, sizeof(Magic)) || header.Version != Version || header.RecordSize != sizeof(TraceRecord)
+		|| file.Size() < sizeof(TraceHeader) + header.Capacity * sizeof(TraceRecord)) {
+		throw std::runtime_error("Not a search trace: " + path);
+	}
+
+	// unroll the ring, oldest record first
+	const auto stored = std::min(header.Written, header.Capacity);
+	const auto ring = (const TraceRecord*)(file.Data() + sizeof(TraceHeader));
+	std::vector<TraceRecord> records(stored);
+	for(uint64_t i = 0; i < stored; i++) {
+		records[i] = ring[(header.Written - stored + i) % header.Capacity];
+	}
+
+	std::cout << header.Written << " nodes traced, " << stored << " kept\n";
+	if(records.empty()) {
+		return;
+	}
+
+	// per iteration node counts from one root record to the next
+	std::cout << "\ndepth     nodes        qnodes       ebf\n";
+	size_t start = 0;
+	uint64_t lastNodes = 0;
+	int lastDepth = -1;
+	uint64_t lastKey = 0;
+
+	for(size_t i = 0; i < records.size(); i++) {
+		if(records[i].Reason != TraceReason::Root) continue;
+
+		uint64_t nodes = 0, qnodes = 0;
+		for(size_t j = start; j < i; j++) {
+			(records[j].Depth ? nodes : qnodes)++;
+		}
+		// the first root may have lost the start of its iteration to the ring
+		const bool partial = start == 0 && header.Written > header.Capacity;
+
+		std::cout << std::setw(5) << (int)records[i].Depth << std::setw(10) << nodes << std::setw(14) << qnodes;
+		if(!partial && records[i].Key == lastKey && records[i].Depth == lastDepth + 1 && lastNodes) {
+			std::cout << std::setw(10) << std::fixed << std::setprecision(2) << (double)nodes / lastNodes << std::defaultfloat;
+		}
+		std::cout << (partial ? "  (partial)" : "") << "\n";
+
+		// more multipv lines of the same iteration add to its count
+		if(records[i].Key == lastKey && records[i].Depth == lastDepth) {
+			lastNodes += nodes;
+		} else {
+			lastNodes = nodes;
+		}
+		lastDepth = records[i].Depth;
+		lastKey = records[i].Key;
+		start = i + 1;
+	}
+
+	// how often the first move is already the one that fails high or is best
+	uint64_t reasons[std::size(ReasonNames)] = {};
+	uint64_t cutoffs = 0, firstCutoffs = 0, cutoffIndexSum = 0;
+	uint64_t exact = 0, firstExact = 0;
+	for(const auto& record : records) {
+		reasons[(int)record.Reason]++;
+		if(!record.Depth || record.Best == SearchTrace::NoMove) continue;
+
+		if(record.Reason == TraceReason::BetaCutoff) {
+			cutoffs++;
+			firstCutoffs += record.Best == 0;
+			cutoffIndexSum += record.Best;
+		} else if(record.Reason == TraceReason::Exact) {
+			exact++;
+			firstExact += record.Best == 0;
+		}
+	}
+
+	std::cout << "\nNode results\n";
+	for(size_t i = 0; i < std::size(ReasonNames); i++) {
+		if(reasons[i]) {
+			std::cout << "  " << ReasonNames[i] << " " << reasons[i] << "\n";
+		}
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "\nOrdering quality\n";
+	if(cutoffs) {
+		std::cout << "  cutoffs on the first move " << firstCutoffs * 100.0 / cutoffs << "%, average cutoff move #" << 1 + (double)cutoffIndexSum / cutoffs << "\n";
+	}
+	if(exact) {
+		std::cout << "  exact nodes with the first move best " << firstExact * 100.0 / exact << "%\n";
+	}
+	std::cout << std::defaultfloat;
+
+	// the last occurrence is the deepest search of the position
+	size_t index = records.size();
+	for(size_t i = records.size(); i-- > 0;) {
+		if(key ? records[i].Key == key : records[i].Reason == TraceReason::Root) {
+			index = i;
+			break;
+		}
+	}
+
+	std::cout << "\n";
+	if(index == records.size()) {
+		std::cout << "Node " << std::hex << key << std::dec << " not in the trace\n";
+		return;
+	}
+	PrintTree(records, index, levels, 0);
+}
+#pragma endregion
@@ -0,0 +1,67 @@
+#pragma once
+#include "../Engine/ChessEngine.h"
+#include "../Engine/MappedFile.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace Players {
+	// Why a node returned its score
+	enum class TraceReason : uint8_t {
+		Exact,
+		FailLow,
+		BetaCutoff,
+		TableCutoff,
+		Draw,
+		Bitbase,
+		Checkmate,
+		Stalemate,
+		StandPat,
+		Root // a finished line of an iteration
+	};
+
+	// One finished node, written after its children so every subtree directly precedes its root
+	struct TraceRecord {
+		uint64_t Key;
+		int16_t Alpha;
+		int16_t Beta;
+		int16_t Score;
+		uint8_t Depth; // 0 in the quiescence search
+		uint8_t Ply;
+		Move Played; // move leading to the node
+		TraceReason Reason;
+		uint8_t Best; // index of the best or cutoff move among the legal moves, NoMove without one
+	};
+	static_assert(sizeof(TraceRecord) == 24);
+
+	struct TraceHeader {
+		char Magic[4];
+		uint32_t Version;
+		uint32_t RecordSize;
+		uint32_t Reserved;
+		uint64_t Capacity;
+		uint64_t Written; // the ring holds the last Capacity of them
+	};
+
+	// Ring buffer of search nodes in a memory mapped file, each searcher writes its own file
+	class SearchTrace {
+	public:
+		static constexpr uint8_t NoMove = 255;
+
+		SearchTrace(const std::string& path, size_t megabytes);
+
+		// The parent sets the move before searching a child
+		void Enter(int ply, Move move) { moves[ply] = move; }
+		void Record(uint64_t key, int alpha, int beta, int score, int depth, int ply, TraceReason reason, int best = NoMove);
+	private:
+		MappedFile file;
+		TraceHeader* header;
+		TraceRecord* records;
+		std::array<Move, 256> moves{};
+	};
+
+	// Iterations with their effective branching factor, move ordering quality and the subtree below key
+	// (the last root when key is 0) down to the given number of levels
+	void AnalyzeTrace(const std::string& path, uint64_t key, int levels);
+}
@@ -0,0 +1,94 @@
+#include "TimeManager.h"
+
+#include <algorithm>
+
+using namespace std::chrono;
+
+// share of the soft limit used after the best move stayed the same for n iterations
+constexpr double StabilityScale[] = { 1.6, 1.2, 1.0, 0.85, 0.7 };
+
+// moves left when the gui doesn't send movestogo
+constexpr int DefaultMovesToGo = 30;
+
+Players::SearchLimits Players::SearchLimits::Parse(const std::vector<std::string>& tokens, bool whiteMove, milliseconds overhead) {
+	SearchLimits limits;
+
+	int64_t time = -1, increment = 0, movesToGo = 0, moveTime = -1;
+
+	for(size_t i = 1; i < tokens.size(); i++) {
+		const auto& token = tokens[i];
+
+		if(token == "infinite") {
+			limits.Infinite = true;
+			continue;
+		}
+		if(i + 1 >= tokens.size()) break;
+
+		const auto value = std::atoll(tokens[i + 1].c_str());
+		if(token == (whiteMove ? "wtime" : "btime")) {
+			time = value;
+		} else if(token == (whiteMove ? "winc" : "binc")) {
+			increment = value;
+		} else if(token == "movestogo") {
+			movesToGo = value;
+		} else if(token == "movetime") {
+			moveTime = value;
+		} else if(token == "depth") {
+			// the root move is one ply by itself
+			limits.Depth = std::max<int>(value - 1, 0);
+		} else if(token == "nodes") {
+			limits.Nodes = value;
+		} else if(token == "mate") {
+			limits.Mate = (int)value;
+		} else {
+			continue;
+		}
+		i++;
+	}
+
+	if(moveTime >= 0) {
+		limits.Soft = limits.Hard = milliseconds(std::max<int64_t>(moveTime - overhead.count(), 1));
+	} else if(time >= 0) {
+		limits.SetClock(time, increment, movesToGo, overhead);
+	}
+
+	return limits;
+}
+
+void Players::SearchLimits::SetClock(int64_t time, int64_t increment, int64_t movesToGo, milliseconds overhead) {
+	const auto available = std::max<int64_t>(time - overhead.count(), 1);
+	const auto moves = movesToGo > 0 ? std::min<int64_t>(movesToGo, DefaultMovesToGo) : DefaultMovesToGo;
+
+	const auto soft = available / moves + increment * 3 / 4;
+	// never more than a third of the clock on one move unless it is the last before the time control
+	const auto maximum = movesToGo == 1 ? available : available / 3;
+
+	Soft = milliseconds(std::clamp<int64_t>(soft, 1, maximum));
+	Hard = milliseconds(std::clamp<int64_t>(soft * 4, 1, maximum));
+}
+
+Players::TimeManager::TimeManager(const SearchLimits& limits) : soft(limits.Soft), hard(limits.Hard) {}
+
+milliseconds Players::TimeManager::Elapsed() const {
+	return duration_cast<milliseconds>(steady_clock::now() - start);
+}
+
+bool Players::TimeManager::OutOfTime() const {
+	return hard.count() && Elapsed() >= hard;
+}
+
+bool Players::TimeManager::NextIteration(Move best) {
+	if(best == last && best.Type == last.Type) {
+		stability = std::min(stability + 1, (int)std::size(StabilityScale) - 1);
+	} else {
+		stability = 0;
+	}
+	last = best;
+
+	if(!soft.count()) {
+		return true;
+	}
+
+	// the next iteration takes several times as long as this one, so it would likely be cut off anyway
+	return Elapsed().count() < soft.count() * StabilityScale[stability] / 2;
+}
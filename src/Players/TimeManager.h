@@ -0,0 +1,47 @@
+#pragma once
+#include "../Engine/Move.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Players {
+	struct SearchLimits {
+		// iterations after the root move, -1 uses the player default
+		int Depth = -1;
+		// 0 means unlimited
+		uint64_t Nodes = 0;
+		// go mate n, solved by the MateSolver instead
+		int Mate = 0;
+		bool Infinite = false;
+
+		// the soft limit is the time a move should take, the hard limit aborts the search, 0 means no limit
+		std::chrono::milliseconds Soft{ 0 };
+		std::chrono::milliseconds Hard{ 0 };
+
+		// Arguments of the uci go command, overhead is reserved for communication per move
+		static SearchLimits Parse(const std::vector<std::string>& tokens, bool whiteMove, std::chrono::milliseconds overhead);
+		// Soft and hard limit for the remaining time and increment in ms, movesToGo 0 if unknown
+		void SetClock(int64_t time, int64_t increment, int64_t movesToGo, std::chrono::milliseconds overhead);
+	};
+
+	class TimeManager {
+	public:
+		TimeManager() = default;
+		TimeManager(const SearchLimits& limits);
+
+		std::chrono::milliseconds Elapsed() const;
+		bool OutOfTime() const;
+
+		// Called after every iteration, a stable best move uses less of the soft limit
+		bool NextIteration(Move best);
+	private:
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::chrono::milliseconds soft{ 0 };
+		std::chrono::milliseconds hard{ 0 };
+
+		Move last;
+		int stability = 0;
+	};
+}
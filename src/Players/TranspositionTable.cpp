@@ -0,0 +1,68 @@
+#include "TranspositionTable.h"
+
+#include <algorithm>
+#include <bit>
+
+// move 17 bits, score 16, depth + 1 8, bound 2
+uint64_t TranspositionTable::Pack(Move best, int score, int depth, Bound type) {
+	const uint64_t move = best.X0 | (best.Y0 << 3) | (best.X1 << 6) | (best.Y1 << 9) | ((uint64_t)best.Type << 12);
+	return move | ((uint64_t)(uint16_t)score << 17) | ((uint64_t)(uint8_t)(depth + 1) << 33) | ((uint64_t)type << 41);
+}
+
+TranspositionEntry TranspositionTable::Unpack(uint64_t key, uint64_t data) {
+	TranspositionEntry entry;
+	entry.Key = key;
+	entry.Best = Move(data & 7, (data >> 3) & 7, (data >> 6) & 7, (data >> 9) & 7, (MoveType)((data >> 12) & 31));
+	entry.Score = (int16_t)(data >> 17);
+	entry.Depth = (int8_t)((data >> 33) & 0xFF) - 1;
+	entry.Type = (Bound)((data >> 41) & 3);
+	return entry;
+}
+
+void TranspositionTable::Resize(size_t megabytes) {
+	// largest power of two that fits
+	const auto count = std::bit_floor(std::max<size_t>(megabytes * 1024 * 1024 / sizeof(Slot), 1));
+
+	entries = std::make_unique<Slot[]>(count);
+	mask = count - 1;
+}
+
+void TranspositionTable::Clear() {
+	for(uint64_t i = 0; i <= mask; i++) {
+		entries[i].Key.store(0, std::memory_order_relaxed);
+		entries[i].Data.store(0, std::memory_order_relaxed);
+	}
+}
+
+bool TranspositionTable::Probe(uint64_t key, TranspositionEntry& entry) const {
+	const auto& slot = entries[key & mask];
+	const auto data = slot.Data.load(std::memory_order_relaxed);
+	if((slot.Key.load(std::memory_order_relaxed) ^ data) != key) {
+		return false;
+	}
+
+	entry = Unpack(key, data);
+	return entry.Depth >= 0;
+}
+
+void TranspositionTable::Store(uint64_t key, Move best, int score, int depth, Bound type) {
+	auto& slot = entries[key & mask];
+
+	const auto oldData = slot.Data.load(std::memory_order_relaxed);
+	const bool same = (slot.Key.load(std::memory_order_relaxed) ^ oldData) == key;
+	if(same) {
+		const auto old = Unpack(key, oldData);
+		if(old.Depth > depth) {
+			return;
+		}
+
+		// keep the old move when this search didn't find one
+		if(best.Type == MoveType::Error) {
+			best = old.Best;
+		}
+	}
+
+	const auto data = Pack(best, score, depth, type);
+	slot.Data.store(data, std::memory_order_relaxed);
+	slot.Key.store(key ^ data, std::memory_order_relaxed);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "../Engine/Move.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+enum class Bound : uint8_t {
+	Exact,
+	Lower, // score >= beta
+	Upper  // score <= alpha
+};
+
+struct TranspositionEntry {
+	uint64_t Key = 0;
+	Move Best;
+	int16_t Score = 0;
+	int8_t Depth = -1;
+	Bound Type = Bound::Exact;
+};
+
+// Search results by position key, kept between searches so later moves and ponder searches start warm.
+// Shared by all search threads without locks, an entry is stored as data and key ^ data
+// so a read that races with a write fails the key check instead of returning mixed results
+class TranspositionTable {
+public:
+	TranspositionTable(size_t megabytes = 16) { Resize(megabytes); }
+
+	void Resize(size_t megabytes);
+	void Clear();
+
+	bool Probe(uint64_t key, TranspositionEntry& entry) const;
+	// Keeps the deeper result for the same position, other positions are always replaced
+	void Store(uint64_t key, Move best, int score, int depth, Bound type);
+private:
+	struct Slot {
+		std::atomic<uint64_t> Key{ 0 };
+		std::atomic<uint64_t> Data{ 0 };
+	};
+
+	std::unique_ptr<Slot[]> entries;
+	uint64_t mask = 0;
+
+	static uint64_t Pack(Move best, int score, int depth, Bound type);
+	static TranspositionEntry Unpack(uint64_t key, uint64_t data);
+};
@@ -0,0 +1,568 @@
+#include "Tournament.h"
+#include "AllPlayers.h"
+#include "Platform.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+// SplitMix64, turns the tournament seed and a game index into independent seeds
+static uint64_t Mix(uint64_t x) {
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+const char* GameEndName(GameEnd end) {
+	static const char* names[] = { "checkmate", "stalemate", "repetition", "fifty moves", "material", "resign", "draw score", "max plies", "time", "forfeit" };
+	return names[(int)end];
+}
+
+// no sequence of moves can mate, bishops on one color can't cover the mating square
+static bool InsufficientMaterial(const ChessEngine& game) {
+	if(game.P | game.R | game.Q) {
+		return false;
+	}
+
+	constexpr uint64_t light = 0x55AA55AA55AA55AAULL;
+	return popcnt64(game.N | game.B) <= 1 || (!game.N && (!(game.B & light) || !(game.B & ~light)));
+}
+
+GameResult Play(Players::Player& white, Players::Player& black, const Adjudication& rules, const ChessEngine& start, const TimeControl& time) {
+	auto game = start;
+	PawnTable pawns(10);
+
+	History history;
+	history.Push(game);
+	white.SetHistory(&history);
+	black.SetHistory(&history);
+
+	Players::Clock clock{ time.Time, time.Time, time.Increment };
+	if(time.Time.count()) {
+		white.SetClock(&clock);
+		black.SetClock(&clock);
+	}
+
+	// consecutive plies a side was lost or the score was level
+	int whiteLost = 0, blackLost = 0, level = 0;
+	GameResult result{ 0, 0, GameEnd::MaxPlies };
+
+	while(result.Plies < rules.MaxPlies) {
+		const auto begin = std::chrono::steady_clock::now();
+		auto move = (game.WhiteMove ? white : black).MakeMove(game);
+
+		if(time.Time.count()) {
+			auto& left = game.WhiteMove ? clock.White : clock.Black;
+			left -= std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+			if(left.count() < 0) {
+				result.Score = game.WhiteMove ? -1 : 1;
+				result.End = GameEnd::Time;
+				break;
+			}
+			left += time.Increment;
+		}
+
+		if(move.Type == MoveType::Error) {
+			// GetValidMoves can let an illegal move through, so legality is checked move by move
+			auto cp = game;
+			if(bestMove(cp, [](Move) { return 0; }).Type != MoveType::Error) {
+				// the player gave up or had nothing legal to say
+				result.Score = game.WhiteMove ? -1 : 1;
+				result.End = GameEnd::Forfeit;
+			} else if(cp.IsCheck()) {
+				result.Score = game.WhiteMove ? -1 : 1;
+				result.End = GameEnd::Checkmate;
+			} else {
+				result.End = GameEnd::Stalemate;
+			}
+			break;
+		}
+		game.MakeMove(move);
+		history.Push(game);
+		result.Plies++;
+
+		if(game.HalfMoves >= 100) {
+			result.End = GameEnd::FiftyMoves;
+			break;
+		}
+		if(history.IsRepetition(rules.FirstRepetition ? 0 : history.Size())) {
+			result.End = GameEnd::Repetition;
+			break;
+		}
+		if(rules.Material && InsufficientMaterial(game)) {
+			result.End = GameEnd::Material;
+			break;
+		}
+
+		if(!rules.ResignScore && !rules.DrawScore) {
+			continue;
+		}
+
+		const auto score = game.WhiteMove ? eval(game, pawns) : -eval(game, pawns);
+
+		whiteLost = score <= -rules.ResignScore ? whiteLost + 1 : 0;
+		blackLost = score >= rules.ResignScore ? blackLost + 1 : 0;
+		if(rules.ResignScore && (whiteLost >= rules.ResignPlies || blackLost >= rules.ResignPlies)) {
+			result.Score = whiteLost ? -1 : 1;
+			result.End = GameEnd::Resign;
+			break;
+		}
+
+		level = std::abs(score) <= rules.DrawScore ? level + 1 : 0;
+		if(rules.DrawScore && level >= rules.DrawPlies && result.Plies >= rules.DrawStart) {
+			result.End = GameEnd::DrawScore;
+			break;
+		}
+	}
+
+	white.SetHistory(nullptr);
+	black.SetHistory(nullptr);
+	white.SetClock(nullptr);
+	black.SetClock(nullptr);
+
+	return result;
+}
+
+std::vector<double> ComputeRatings(size_t players, const std::vector<GameRecord>& games) {
+	// points and games between every pair
+	std::vector<double> points(players, 0);
+	std::vector<std::vector<double>> played(players, std::vector<double>(players, 0));
+
+	for(const auto& game : games) {
+		played[game.White][game.Black]++;
+		played[game.Black][game.White]++;
+		points[game.White] += (game.Result.Score + 1) / 2.0;
+		points[game.Black] += (1 - game.Result.Score) / 2.0;
+	}
+
+	// one virtual draw per pair that met keeps players without wins or losses finite
+	for(size_t i = 0; i < players; i++) {
+		for(size_t j = 0; j < players; j++) {
+			if(i == j || !played[i][j]) continue;
+			played[i][j] += 1;
+			points[i] += 0.5;
+		}
+	}
+
+	// Bradley-Terry strengths with the minorization-maximization update
+	std::vector<double> strength(players, 1);
+	for(int iteration = 0; iteration < 10000; iteration++) {
+		double change = 0;
+
+		for(size_t i = 0; i < players; i++) {
+			double sum = 0;
+			for(size_t j = 0; j < players; j++) {
+				if(i != j) sum += played[i][j] / (strength[i] + strength[j]);
+			}
+
+			const auto next = sum > 0 ? points[i] / sum : strength[i];
+			change = std::max(change, std::abs(next - strength[i]) / strength[i]);
+			strength[i] = next;
+		}
+		if(change < 1e-9) break;
+	}
+
+	std::vector<double> ratings(players);
+	for(size_t i = 0; i < players; i++) {
+		ratings[i] = 400 * std::log10(strength[i]);
+	}
+	const auto mean = std::accumulate(ratings.begin(), ratings.end(), 0.0) / players;
+	for(auto& rating : ratings) {
+		rating += 1000 - mean;
+	}
+	return ratings;
+}
+
+static void PrintResults(const std::vector<std::string>& names, const std::vector<GameRecord>& games, double passed);
+
+void RunElo(int rounds, uint64_t seed, const Adjudication& rules) {
+	const std::vector<Entrant> entrants = {
+		makeEntrant<Players::Pacifist>("Pacifist"),
+		makeEntrant<Players::Generous>("Generous"),
+		makeEntrant<Players::Huddle>("Huddle"),
+		makeEntrant<Players::SameColor>("SameColor"),
+		makeEntrant<Players::OppositeColor>("OppositeColor"),
+		{ "Random", [](uint64_t seed) { return std::make_unique<Players::Random>(seed); } },
+		makeEntrant<Players::Swarm>("Swarm"),
+
+		// makeEntrant<Players::MinOpptMoves>("MinOpptMoves"),
+		// makeEntrant<Players::Negamax>("Negamax", 3),
+	};
+
+	std::vector<GameRecord> games;
+	for(int round = 0; round < rounds; round++) {
+		for(int white = 0; white < entrants.size(); white++) {
+			for(int black = 0; black < entrants.size(); black++) {
+				if(white != black) games.push_back({ white, black });
+			}
+		}
+	}
+
+	const auto begin = std::chrono::steady_clock::now();
+
+	// every game only depends on its own index, so the results are the same for any thread count and order
+#pragma omp parallel for schedule(dynamic, 16)
+	for(int i = 0; i < games.size(); i++) {
+		auto& game = games[i];
+		const auto gameSeed = Mix(seed ^ Mix(i));
+
+		auto white = entrants[game.White].Create(gameSeed);
+		auto black = entrants[game.Black].Create(Mix(gameSeed));
+		game.Result = Play(*white, *black, rules);
+	}
+
+	const auto passed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	std::vector<std::string> names;
+	for(const auto& entrant : entrants) {
+		names.push_back(entrant.Name);
+	}
+	PrintResults(names, games, passed);
+}
+
+static void PrintResults(const std::vector<std::string>& names, const std::vector<GameRecord>& games, double passed) {
+	const auto ratings = ComputeRatings(names.size(), games);
+
+	struct Row {
+		int Wins = 0, Draws = 0, Losses = 0;
+	};
+	std::vector<Row> rows(names.size());
+	uint64_t plies = 0;
+	int ends[(int)GameEnd::Count]{};
+
+	for(const auto& game : games) {
+		const auto score = game.Result.Score;
+		if(score == 0) {
+			rows[game.White].Draws++;
+			rows[game.Black].Draws++;
+		} else {
+			rows[score > 0 ? game.White : game.Black].Wins++;
+			rows[score > 0 ? game.Black : game.White].Losses++;
+		}
+
+		plies += game.Result.Plies;
+		ends[(int)game.Result.End]++;
+	}
+
+	std::vector<int> order(names.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return ratings[a] > ratings[b]; });
+
+	printf("%-24s %7s %7s %7s %7s %7s\n", "player", "rating", "score", "wins", "draws", "losses");
+	for(const auto i : order) {
+		const auto& row = rows[i];
+		const auto played = row.Wins + row.Draws + row.Losses;
+		printf("%-24s %7.0f %6.1f%% %7i %7i %7i\n", names[i].c_str(), ratings[i],
+			played ? (row.Wins + row.Draws / 2.0) * 100 / played : 0.0, row.Wins, row.Draws, row.Losses);
+	}
+
+	printf("\n%-24s %7s %7s\n", "game end", "games", "share");
+	for(int i = 0; i < (int)GameEnd::Count; i++) {
+		printf("%-24s %7i %6.1f%%\n", GameEndName((GameEnd)i), ends[i], ends[i] * 100.0 / std::max<size_t>(games.size(), 1));
+	}
+	printf("%.1f plies per game, %llu plies total\n", plies / (double)std::max<size_t>(games.size(), 1), (unsigned long long)plies);
+	printf("%zu games in %.1fs = %.0f games/s\n", games.size(), passed, games.size() / passed);
+}
+
+EngineConfig EngineConfig::Parse(const std::string& text) {
+	EngineConfig config;
+
+	std::istringstream stream(text);
+	std::string option;
+	while(std::getline(stream, option, ',')) {
+		const auto split = option.find('=');
+		if(split == std::string::npos) {
+			throw std::runtime_error("Expected key=value in " + option);
+		}
+
+		const auto key = option.substr(0, split);
+		const auto value = option.substr(split + 1);
+
+		try {
+			if(key == "depth") {
+				config.Depth = std::stoi(value);
+			} else if(key == "nodes") {
+				config.Nodes = std::stoull(value);
+			} else if(key == "hash") {
+				config.Hash = std::stoull(value);
+			} else if(key == "nnue") {
+				config.Network = value;
+			} else {
+				throw std::runtime_error("Unknown engine option " + key);
+			}
+		} catch(const std::logic_error&) {
+			// stoi and stoull only say which function failed
+			throw std::runtime_error("Invalid value for " + key + ": " + value);
+		}
+	}
+	return config;
+}
+
+PlayerFactory EngineConfig::Factory() const {
+	// the network is loaded once and shared by all games
+	std::shared_ptr<const Nnue::Network> network;
+	if(!Network.empty()) {
+		network = std::make_shared<Nnue::Network>(Network);
+	}
+
+	return [config = *this, network](uint64_t) {
+		auto player = std::make_unique<Players::Negamax>(config.Depth);
+		player->SetHashSize(config.Hash);
+		player->Limits.Nodes = config.Nodes;
+		if(network) {
+			player->UseNetwork(network);
+		}
+		return player;
+	};
+}
+
+static double ScoreFromElo(double elo) {
+	return 1 / (1 + std::pow(10, -elo / 400));
+}
+
+static double EloFromScore(double score) {
+	return -400 * std::log10(1 / score - 1);
+}
+
+// mean and variance of the pair scores scaled to 0..1, prior is added to every outcome
+static void PairStats(const int (&pairs)[5], double& count, double& mean, double& variance, double prior = 0) {
+	count = 0;
+	double sum = 0, squares = 0;
+	for(int i = 0; i < 5; i++) {
+		const auto score = i / 4.0;
+		const auto n = pairs[i] + prior;
+		count += n;
+		sum += n * score;
+		squares += n * score * score;
+	}
+
+	mean = count ? sum / count : 0.5;
+	variance = count ? squares / count - mean * mean : 0;
+}
+
+double SprtLlr(const int (&pairs)[5], double elo0, double elo1) {
+	// a small prior keeps the variance of the first few pairs or of identical engines from being 0
+	double count, mean, variance;
+	PairStats(pairs, count, mean, variance, 0.1);
+
+	const auto s0 = ScoreFromElo(elo0);
+	const auto s1 = ScoreFromElo(elo1);
+	return count * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+ChessEngine BalancedOpening(uint64_t seed) {
+	constexpr int plies = 8;
+	constexpr int margin = 60;
+
+	std::mt19937_64 rng(seed);
+	Players::Negamax judge(3);
+	judge.SetHashSize(1);
+
+	int score = 0;
+	judge.OnIteration = [&](const Players::SearchInfo& info) { score = info.Score; };
+
+	while(true) {
+		auto game = ChessEngine();
+
+		bool valid = true;
+		for(int i = 0; i < plies && valid; i++) {
+			auto moves = game.GetValidMoves();
+			if(moves.empty()) {
+				valid = false;
+				break;
+			}
+
+			game.MakeMove(moves[rng() % moves.size()]);
+			valid = game.IsValid();
+		}
+
+		auto cp = game;
+		if(!valid || cp.GetValidMoves().empty()) {
+			continue;
+		}
+
+		judge.NewGame();
+		judge.MakeMove(game);
+		if(std::abs(score) <= margin) {
+			return game;
+		}
+	}
+}
+
+std::vector<ChessEngine> LoadOpenings(const std::string& path) {
+	std::ifstream file(path);
+	if(!file.is_open()) {
+		throw std::runtime_error("Could not open " + path);
+	}
+
+	std::vector<ChessEngine> openings;
+	std::string line;
+	while(std::getline(file, line)) {
+		line = line.substr(0, line.find(';'));
+		if(line.find_first_not_of(' ') != std::string::npos) {
+			openings.emplace_back(line);
+		}
+	}
+	if(openings.empty()) {
+		throw std::runtime_error("No openings in " + path);
+	}
+	return openings;
+}
+
+void RunSprt(const EngineConfig& first, const EngineConfig& second, const SprtBounds& bounds, int maxPairs, const std::string& openingsPath) {
+	const auto lower = std::log(bounds.Beta / (1 - bounds.Alpha));
+	const auto upper = std::log((1 - bounds.Beta) / bounds.Alpha);
+
+	const auto openings = openingsPath.empty() ? std::vector<ChessEngine>() : LoadOpenings(openingsPath);
+
+	const auto createFirst = first.Factory();
+	const auto createSecond = second.Factory();
+	const Adjudication rules;
+
+	// half points of the first engine in both games of a pair
+	struct PairResult {
+		bool Done = false;
+		int Points[2];
+	};
+	std::vector<PairResult> results(maxPairs);
+	int pairs[5]{};
+	int merged = 0, wins = 0, draws = 0, losses = 0;
+	double llr = 0;
+
+	std::atomic<int> next = 0;
+	std::atomic<bool> done = false;
+
+	const auto begin = std::chrono::steady_clock::now();
+
+	const auto report = [&]() {
+		double count, mean, variance;
+		PairStats(pairs, count, mean, variance);
+
+		const auto clamped = std::clamp(mean, 1e-3, 1 - 1e-3);
+		const auto error = count ? 1.96 * std::sqrt(variance / count) : 0;
+		const auto low = EloFromScore(std::clamp(clamped - error, 1e-3, 1 - 1e-3));
+		const auto high = EloFromScore(std::clamp(clamped + error, 1e-3, 1 - 1e-3));
+
+		printf("pairs %i  W %i D %i L %i  elo %.1f [%.1f, %.1f]  LLR %.2f [%.2f, %.2f]\n",
+			merged, wins, draws, losses, EloFromScore(clamped), low, high, llr, lower, upper);
+	};
+
+	// games of one pair run on the same thread, pairs are merged in order so the stopping point doesn't depend on timing
+#pragma omp parallel
+	while(!done) {
+		const auto pair = next++;
+		if(pair >= maxPairs) break;
+
+		// without a file every pair generates its own opening
+		const auto start = openings.empty() ? BalancedOpening(Mix(pair)) : openings[pair % openings.size()];
+
+		PairResult result{ true };
+		for(int swap = 0; swap < 2; swap++) {
+			auto a = createFirst(pair);
+			auto b = createSecond(pair);
+
+			const auto score = (swap ? Play(*b, *a, rules, start) : Play(*a, *b, rules, start)).Score;
+			result.Points[swap] = swap ? 1 - score : 1 + score;
+		}
+
+#pragma omp critical
+		{
+			results[pair] = result;
+
+			while(!done && merged < maxPairs && results[merged].Done) {
+				for(const auto points : results[merged].Points) {
+					wins += points == 2;
+					draws += points == 1;
+					losses += points == 0;
+				}
+				pairs[results[merged].Points[0] + results[merged].Points[1]]++;
+				merged++;
+				llr = SprtLlr(pairs, bounds.Elo0, bounds.Elo1);
+
+				done = llr <= lower || llr >= upper || merged == maxPairs;
+				if(merged % 50 == 0 && !done) {
+					report();
+				}
+			}
+		}
+	}
+
+	const auto passed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	report();
+	printf("%s after %i games in %.1fs\n", llr >= upper ? "H1 accepted" : llr <= lower ? "H0 accepted" : "Inconclusive", merged * 2, passed);
+}
+
+void RunGauntlet(const EngineConfig& config, const std::vector<std::string>& commands, int rounds, const TimeControl& time) {
+	std::vector<Entrant> entrants = { { "Negamax", config.Factory() } };
+
+	// one instance up front checks the command and asks for the engine name
+	for(const auto& command : commands) {
+		const auto name = Players::External(command).Name();
+		entrants.push_back({ name, [command](uint64_t) { return std::make_unique<Players::External>(command); } });
+	}
+
+	const int opponents = entrants.size() - 1;
+	std::vector<ChessEngine> openings(rounds * opponents);
+
+#pragma omp parallel for schedule(dynamic, 1)
+	for(int i = 0; i < openings.size(); i++) {
+		openings[i] = BalancedOpening(Mix(i));
+	}
+
+	// every opening is played with both colors
+	std::vector<GameRecord> games;
+	for(int i = 0; i < openings.size(); i++) {
+		const auto opponent = 1 + i % opponents;
+		games.push_back({ 0, opponent });
+		games.push_back({ opponent, 0 });
+	}
+
+	const Adjudication rules;
+	const auto begin = std::chrono::steady_clock::now();
+	int finished = 0;
+
+	// only one side of a game thinks at a time, so every thread runs one game
+#pragma omp parallel for schedule(dynamic, 1)
+	for(int i = 0; i < games.size(); i++) {
+		auto& game = games[i];
+
+		// exceptions can't leave the parallel loop, an engine that doesn't start loses the game
+		std::unique_ptr<Players::Player> white, black;
+		std::string error;
+		try {
+			white = entrants[game.White].Create(i);
+			black = entrants[game.Black].Create(i);
+			game.Result = Play(*white, *black, rules, openings[i / 2], time);
+		} catch(const std::exception& e) {
+			game.Result = { white ? 1 : -1, 0, GameEnd::Forfeit };
+			error = e.what();
+		}
+
+#pragma omp critical
+		{
+			finished++;
+			if(!error.empty()) {
+				printf("%s\n", error.c_str());
+			}
+			printf("game %i/%zu %s - %s %s (%s)\n", finished, games.size(), entrants[game.White].Name.c_str(), entrants[game.Black].Name.c_str(),
+				game.Result.Score > 0 ? "1-0" : game.Result.Score < 0 ? "0-1" : "1/2-1/2", GameEndName(game.Result.End));
+		}
+	}
+
+	const auto passed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	std::vector<std::string> names;
+	for(const auto& entrant : entrants) {
+		names.push_back(entrant.Name);
+	}
+	PrintResults(names, games, passed);
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include "Players/Player.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Every game gets fresh players, the seed makes random players reproducible
+using PlayerFactory = std::function<std::unique_ptr<Players::Player>(uint64_t seed)>;
+
+struct Entrant {
+	std::string Name;
+	PlayerFactory Create;
+};
+
+template<class T, class... Types>
+Entrant makeEntrant(std::string name, Types... args) {
+	return { std::move(name), [=](uint64_t) { return std::make_unique<T>(args...); } };
+}
+
+// Ends games early once the outcome is clear, scores are static evaluations from white's view
+struct Adjudication {
+	// a side loses once it is this many centipawns behind for ResignPlies plies in a row, 0 turns it off
+	int ResignScore = 1000;
+	int ResignPlies = 8;
+
+	// draw after the score stayed within DrawScore for DrawPlies plies, not before ply DrawStart, 0 turns it off
+	int DrawScore = 20;
+	int DrawPlies = 40;
+	int DrawStart = 60;
+
+	// draw without mating material on the board
+	bool Material = true;
+	// draw on the first repeated position instead of the third
+	bool FirstRepetition = true;
+
+	int MaxPlies = 200;
+};
+
+enum class GameEnd {
+	Checkmate,
+	Stalemate,
+	Repetition,
+	FiftyMoves,
+	Material,
+	Resign,
+	DrawScore,
+	MaxPlies,
+	Time,
+	Forfeit, // no move or an illegal one although there were legal moves
+	Count
+};
+
+const char* GameEndName(GameEnd end);
+
+struct GameResult {
+	int Score; // 1 white wins, 0 draw, -1 black wins
+	int Plies;
+	GameEnd End;
+};
+
+struct GameRecord {
+	int White;
+	int Black;
+	GameResult Result;
+};
+
+// Base time and increment of both sides, a base time of 0 plays without clock
+struct TimeControl {
+	std::chrono::milliseconds Time{ 0 };
+	std::chrono::milliseconds Increment{ 0 };
+};
+
+// Plays one game from the given position, a side that runs out of time loses
+GameResult Play(Players::Player& white, Players::Player& black, const Adjudication& rules = {}, const ChessEngine& start = ChessEngine(), const TimeControl& time = {});
+
+// Elo ratings around 1000 fitted to all games at once
+std::vector<double> ComputeRatings(size_t players, const std::vector<GameRecord>& games);
+
+// Round robin where every pairing is played with both colors each round, the games run on all cores
+void RunElo(int rounds, uint64_t seed, const Adjudication& rules = {});
+
+// Negamax settings given as "depth=4,nodes=20000,hash=16,nnue=net.bin", missing keys keep their default
+struct EngineConfig {
+	int Depth = 4;
+	uint64_t Nodes = 0;
+	size_t Hash = 16;
+	std::string Network;
+
+	static EngineConfig Parse(const std::string& text);
+	PlayerFactory Factory() const;
+};
+
+// Sequential probability ratio test, elo0 is the null hypothesis and elo1 the alternative
+struct SprtBounds {
+	double Elo0 = 0;
+	double Elo1 = 5;
+	double Alpha = 0.05;
+	double Beta = 0.05;
+};
+
+// Log likelihood ratio of elo1 against elo0 from the number of game pairs that scored 0, 0.5, 1, 1.5 and 2 points
+double SprtLlr(const int (&pairs)[5], double elo0, double elo1);
+
+// Opening a few random plies deep that a short search considers level
+ChessEngine BalancedOpening(uint64_t seed);
+// One fen or epd position per line
+std::vector<ChessEngine> LoadOpenings(const std::string& path);
+
+// Plays both colors of every opening in parallel until the ratio crosses a bound or maxPairs pairs are done
+void RunSprt(const EngineConfig& first, const EngineConfig& second, const SprtBounds& bounds, int maxPairs, const std::string& openingsPath = "");
+
+// Negamax plays both colors of a balanced opening against every uci engine command per round, the games run concurrently
+void RunGauntlet(const EngineConfig& config, const std::vector<std::string>& commands, int rounds, const TimeControl& time);
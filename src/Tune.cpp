@@ -0,0 +1,252 @@
+#include "Tune.h"
+#include "DataGen.h"
+#include "Platform.h"
+#include "Engine/MappedFile.h"
+#include "Players/Negamax.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+// middle game weights of piece type * 64 + square followed by the same for the endgame, material included
+constexpr int Features = 6 * 64;
+constexpr int Weights = 2 * Features;
+
+// positions handed to a thread at once
+constexpr size_t ChunkSize = 1 << 16;
+
+struct Chunk {
+	const PackedPosition* Positions;
+	size_t Count;
+	// index of the first position in the pawn structure offsets
+	size_t First;
+};
+
+// Calls add(feature, sign) for every piece, returns the game phase
+template<class F>
+static int ForEachPiece(const PackedPosition& position, F&& add) {
+	int count = 0, phase = 0;
+	for(auto rest = position.Occupied; rest; rest &= rest - 1) {
+		const int bit = NumberOfTrailingZeros(rest);
+		const int piece = (position.Pieces[count / 2] >> (count % 2 * 4)) & 15;
+		count++;
+
+		// tables start at a8 and are mirrored for black like in eval
+		const int type = piece / 2;
+		const bool black = piece & 1;
+		const int square = black ? (63 - bit) ^ 56 : 63 - bit;
+
+		phase += PestoPhase(type);
+		add(type * 64 + square, black ? -1 : 1);
+	}
+	return std::min(phase, 24);
+}
+
+static double Sigmoid(double x) {
+	return 1 / (1 + std::exp(-x));
+}
+
+class Tuner {
+public:
+	Tuner(const std::vector<std::string>& paths, double lambda) : lambda(lambda) {
+		for(const auto& path : paths) {
+			files.push_back(std::make_unique<MappedFile>(path));
+			const auto& file = *files.back();
+			if(file.Size() % sizeof(PackedPosition)) {
+				throw std::runtime_error(path + " is not a position file");
+			}
+
+			const auto positions = (const PackedPosition*)file.Data();
+			const auto count = file.Size() / sizeof(PackedPosition);
+			for(size_t i = 0; i < count; i += ChunkSize) {
+				chunks.push_back({ positions + i, std::min(ChunkSize, count - i), total + i });
+			}
+			total += count;
+		}
+		if(!total) {
+			throw std::runtime_error("No positions");
+		}
+
+		for(int piece = 0; piece < 6; piece++) {
+			for(int square = 0; square < 64; square++) {
+				weights[piece * 64 + square] = PestoMaterial(false, piece) + PestoSquare(false, piece, square);
+				weights[Features + piece * 64 + square] = PestoMaterial(true, piece) + PestoSquare(true, piece, square);
+			}
+		}
+
+		// the pawn structure terms stay as they are, so they are computed once
+		pawnMg.resize(total);
+		pawnEg.resize(total);
+#pragma omp parallel
+		{
+			PawnTable pawns;
+#pragma omp for schedule(dynamic, 1)
+			for(int i = 0; i < chunks.size(); i++) {
+				const auto& chunk = chunks[i];
+				for(size_t j = 0; j < chunk.Count; j++) {
+					const auto& entry = pawns.Probe(chunk.Positions[j].Unpack());
+					pawnMg[chunk.First + j] = entry.Mg;
+					pawnEg[chunk.First + j] = entry.Eg;
+				}
+			}
+		}
+	}
+
+	size_t Size() const { return total; }
+
+	// Mean squared error between the target and the predicted score, gradient is only filled when given
+	double Loss(double k, double* gradient = nullptr) const {
+		const auto scale = k / 400;
+		double loss = 0;
+
+		if(gradient) {
+			std::fill(gradient, gradient + Weights, 0.0);
+		}
+
+#pragma omp parallel reduction(+:loss)
+		{
+			double local[Weights]{};
+
+#pragma omp for schedule(dynamic, 1)
+			for(int i = 0; i < chunks.size(); i++) {
+				const auto& chunk = chunks[i];
+				for(size_t j = 0; j < chunk.Count; j++) {
+					const auto& position = chunk.Positions[j];
+
+					double mg = pawnMg[chunk.First + j], eg = pawnEg[chunk.First + j];
+					const auto phase = ForEachPiece(position, [&](int feature, int sign) {
+						mg += sign * weights[feature];
+						eg += sign * weights[Features + feature];
+					});
+					const auto eval = (mg * phase + eg * (24 - phase)) / 24;
+
+					const auto target = lambda * position.Result / 2 + (1 - lambda) * Sigmoid(position.Score * scale);
+					const auto predicted = Sigmoid(eval * scale);
+					const auto error = target - predicted;
+					loss += error * error;
+
+					if(gradient) {
+						// the eval is linear in the weights, so its derivative is just the phase weighted piece count
+						const auto factor = -2 * error * predicted * (1 - predicted) * scale;
+						ForEachPiece(position, [&](int feature, int sign) {
+							local[feature] += factor * sign * phase / 24;
+							local[Features + feature] += factor * sign * (24 - phase) / 24;
+						});
+					}
+				}
+			}
+
+			if(gradient) {
+#pragma omp critical
+				for(int i = 0; i < Weights; i++) {
+					gradient[i] += local[i];
+				}
+			}
+		}
+
+		if(gradient) {
+			for(int i = 0; i < Weights; i++) {
+				gradient[i] /= total;
+			}
+		}
+		return loss / total;
+	}
+
+	// Scaling of the sigmoid that fits the starting weights best, found by ternary search
+	double FitK() const {
+		double low = 0.1, high = 5;
+		for(int i = 0; i < 40; i++) {
+			const auto a = low + (high - low) / 3;
+			const auto b = high - (high - low) / 3;
+			if(Loss(a) < Loss(b)) {
+				high = b;
+			} else {
+				low = a;
+			}
+		}
+		return (low + high) / 2;
+	}
+
+	double weights[Weights];
+private:
+	std::vector<std::unique_ptr<MappedFile>> files;
+	std::vector<Chunk> chunks;
+	size_t total = 0;
+
+	std::vector<int16_t> pawnMg, pawnEg;
+	double lambda;
+};
+
+static void WriteTables(const std::string& path, const double* weights, size_t positions, double loss) {
+	std::ofstream file(path);
+	if(!file.is_open()) {
+		throw std::runtime_error("Could not open " + path);
+	}
+
+	static const char* names[] = { "pawn", "knight", "bishop", "rook", "queen", "king" };
+	char number[16];
+
+	file << "/* tuned on " << positions << " positions, loss " << loss << " */\n";
+	for(int endgame = 0; endgame < 2; endgame++) {
+		const auto prefix = endgame ? "eg" : "mg";
+		file << "\nconstexpr int " << prefix << "_pesto_table[6][64] = {\n";
+
+		for(int piece = 0; piece < 6; piece++) {
+			file << "    // " << prefix << "_" << names[piece] << "_table\n    {\n";
+			for(int square = 0; square < 64; square++) {
+				// the material values stay as they are, so the table takes the difference
+				const auto value = (int)std::lround(weights[endgame * Features + piece * 64 + square]) - PestoMaterial(endgame, piece);
+
+				// pawns never stand on the first or last rank
+				snprintf(number, sizeof(number), "%4d,", piece == 0 && (square < 8 || square >= 56) ? 0 : value);
+				file << (square % 8 == 0 ? "        " : " ") << number << (square % 8 == 7 ? "\n" : "");
+			}
+			file << "    }" << (piece < 5 ? "," : "") << "\n";
+		}
+		file << "};\n";
+	}
+}
+
+void Tune(const std::vector<std::string>& paths, const std::string& outputPath, int epochs, double lambda) {
+	const auto begin = std::chrono::steady_clock::now();
+	const auto elapsed = [&]() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	};
+
+	Tuner tuner(paths, lambda);
+	printf("Loaded %zu positions in %.1fs\n", tuner.Size(), elapsed());
+
+	const auto k = tuner.FitK();
+	printf("K = %.3f, loss %.6f\n", k, tuner.Loss(k));
+
+	// Adam with the usual decay rates, the step is in centipawns
+	constexpr double rate = 1, beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+	std::vector<double> gradient(Weights), m(Weights), v(Weights);
+
+	const auto start = elapsed();
+	double loss = 0;
+	for(int epoch = 1; epoch <= epochs; epoch++) {
+		loss = tuner.Loss(k, gradient.data());
+
+		for(int i = 0; i < Weights; i++) {
+			m[i] = beta1 * m[i] + (1 - beta1) * gradient[i];
+			v[i] = beta2 * v[i] + (1 - beta2) * gradient[i] * gradient[i];
+
+			const auto mHat = m[i] / (1 - std::pow(beta1, epoch));
+			const auto vHat = v[i] / (1 - std::pow(beta2, epoch));
+			tuner.weights[i] -= rate * mHat / (std::sqrt(vHat) + epsilon);
+		}
+
+		if(epoch % 10 == 0 || epoch == epochs) {
+			printf("epoch %i loss %.6f %.0f positions/s\n", epoch, loss, tuner.Size() * epoch / (elapsed() - start));
+			fflush(stdout);
+		}
+	}
+
+	WriteTables(outputPath, tuner.weights, tuner.Size(), tuner.Loss(k));
+	printf("Wrote %s after %.1fs\n", outputPath.c_str(), elapsed());
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Fits the PeSTO piece square tables to positions written by DataGen with Adam and writes them as C++ source to outputPath,
+// lambda weighs the game result against the search score
+void Tune(const std::vector<std::string>& paths, const std::string& outputPath, int epochs, double lambda);